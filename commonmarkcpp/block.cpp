@@ -44,6 +44,7 @@
 // C++ lib
 //
 #include    <iostream>
+#include    <vector>
 
 
 // last include
@@ -57,6 +58,34 @@ namespace cm
 
 
 
+namespace
+{
+
+
+
+bool is_list_item_type(char32_t type)
+{
+    switch(type)
+    {
+    case BLOCK_TYPE_LIST_ASTERISK:
+    case BLOCK_TYPE_LIST_PLUS:
+    case BLOCK_TYPE_LIST_DASH:
+    case BLOCK_TYPE_LIST_PERIOD:
+    case BLOCK_TYPE_LIST_PARENTHESIS:
+        return true;
+
+    }
+
+    return false;
+}
+
+
+
+}
+// no name namespace
+
+
+
 std::string type_to_string(char32_t type)
 {
     switch(type)
@@ -124,6 +153,9 @@ std::string type_to_string(char32_t type)
     case BLOCK_TYPE_BREAK_UNDERLINE:
         return "BREAK_UNDERLINE";
 
+    case BLOCK_TYPE_EXTENSION:
+        return "EXTENSION";
+
     default:
         return "<unknown type>";
 
@@ -154,6 +186,49 @@ block::block(character const & type)
 }
 
 
+/** \brief Clean up the block.
+ *
+ * The siblings and children of a block are owned through shared
+ * pointers. Just releasing those pointers would destroy the tree
+ * recursively, using one level of recursion per sibling and per child.
+ * With very large or very deeply nested documents, that can overflow the
+ * stack of the thread. Instead, the blocks we are the only owner of get
+ * detached from the tree and released one at a time.
+ */
+block::~block()
+{
+    std::vector<pointer_t> release;
+    f_last_child.reset();
+    if(f_first_child != nullptr)
+    {
+        release.push_back(std::move(f_first_child));
+    }
+    if(f_next != nullptr)
+    {
+        release.push_back(std::move(f_next));
+    }
+
+    while(!release.empty())
+    {
+        pointer_t b(std::move(release.back()));
+        release.pop_back();
+        if(b.use_count() == 1)
+        {
+            b->f_last_child.reset();
+            if(b->f_first_child != nullptr)
+            {
+                release.push_back(std::move(b->f_first_child));
+            }
+            if(b->f_next != nullptr)
+            {
+                release.push_back(std::move(b->f_next));
+            }
+        }
+        // `b` gets destroyed here, it has no more siblings or children
+    }
+}
+
+
 /** \brief Retrieve the type of the block.
  *
  * This function returns the type of this block. The type is saved at the
@@ -355,22 +430,74 @@ bool block::is_tight_list() const
         //return !b->first_child()->includes_blocks_with_empty_lines(false);
     }
 
-    for(; b != nullptr && b->type().f_char == type; b = b->next())
+    // the list is loose if any item other than the last one is followed
+    // by an empty line; the last item can be followed by an empty line
+    // if the list is followed by another block; the number of items
+    // followed by an empty line is tracked on the first item as the
+    // document gets parsed so we do not have to walk the list here
+    //
+    block const * head(list_head());
+    pointer_t const last(head->f_list_tail.lock());
+    block const * tail(last != nullptr ? last.get() : head);
+    std::uint32_t count(head->f_list_empty_lines);
+    if(tail->followed_by_an_empty_line())
+    {
+        --count;
+        return count == 0 && tail->next() != nullptr;
+    }
+
+    return count == 0;
+}
+
+
+/** \brief Retrieve the first item of the list this item is part of.
+ *
+ * \return The first item of the list or `this` if this block is the
+ * first item or is not a list item.
+ */
+block const * block::list_head() const
+{
+    pointer_t const head(f_list_head.lock());
+    if(head != nullptr)
+    {
+        return head.get();
+    }
+    return this;
+}
+
+
+/** \brief Recompute the list information starting with \p head.
+ *
+ * The list items save a pointer to the first item of their list and
+ * the first item saves a pointer to the last item and the number of
+ * items followed by an empty line. This function recomputes all of that
+ * for the list starting at \p head. It is used when list items get
+ * unlinked, which is rare.
+ *
+ * \param[in] head  The first item of a list.
+ */
+void block::index_list(pointer_t head)
+{
+    char32_t const type(head->f_type.f_char);
+    std::uint32_t count(0);
+    pointer_t tail(head);
+    head->f_list_head.reset();
+    for(pointer_t b(head); b != nullptr && b->f_type.f_char == type; b = b->f_next)
     {
-        if(b->followed_by_an_empty_line())
-        //|| (b->first_child() != nullptr
-        //        && b->first_child()->includes_blocks_with_empty_lines(false)))
+        if(b != head)
         {
-            if(b->next() != nullptr
-            && b->next()->type().f_char != type)
-            {
-                return true;
-            }
-            return false;
+            b->f_list_head = head;
+            b->f_list_tail.reset();
+            b->f_list_empty_lines = 0;
+        }
+        if(b->f_followed_by_an_empty_line)
+        {
+            ++count;
         }
+        tail = b;
     }
-
-    return true;
+    head->f_list_tail = tail;
+    head->f_list_empty_lines = count;
 }
 
 
@@ -713,6 +840,20 @@ int block::number() const
  */
 void block::followed_by_an_empty_line(bool followed)
 {
+    if(followed != f_followed_by_an_empty_line
+    && is_list_item_type(f_type.f_char))
+    {
+        block * head(const_cast<block *>(list_head()));
+        if(followed)
+        {
+            ++head->f_list_empty_lines;
+        }
+        else
+        {
+            --head->f_list_empty_lines;
+        }
+    }
+
     f_followed_by_an_empty_line = followed;
 }
 
@@ -732,7 +873,7 @@ bool block::followed_by_an_empty_line() const
 
 /** \brief Check whether a block is followed by a new line.
  *
- * This function is recursive. It will check whether this block, any of
+ * This function checks whether this block, any of
  * its following siblings (not preceeding), or any of its children is
  * followed by an empty line.
  *
@@ -752,17 +893,30 @@ bool block::includes_blocks_with_empty_lines(bool recursive) const
         throw std::logic_error("can't shared_from_this() in is_tight_list()");
     }
 
-    for(; b != nullptr; b = b->next())
+    // the children are checked using an explicit stack instead of
+    // recursion so very deep trees can't overflow the stack
+    //
+    std::vector<pointer_t> stack;
+    stack.reserve(32);
+    stack.push_back(b);
+    while(!stack.empty())
     {
-        // TBD: we may need to limit to tests to blocks of type LIST and
-        //      BLOCKQUOTE...
-        //
-        if(b->followed_by_an_empty_line()
-        || (recursive
-                && b->first_child() != nullptr
-                && b->first_child()->includes_blocks_with_empty_lines(true)))
+        b = stack.back();
+        stack.pop_back();
+        for(; b != nullptr; b = b->next())
         {
-            return true;
+            // TBD: we may need to limit to tests to blocks of type LIST and
+            //      BLOCKQUOTE...
+            //
+            if(b->followed_by_an_empty_line())
+            {
+                return true;
+            }
+            if(recursive
+            && b->first_child() != nullptr)
+            {
+                stack.push_back(b->first_child());
+            }
         }
     }
 
@@ -901,6 +1055,19 @@ void block::link_sibling(pointer_t sibling)
     sibling->f_previous = lc;
     lc->f_next = sibling;
     p->f_last_child = sibling;
+
+    // keep track of the list this new item is part of
+    //
+    if(is_list_item_type(sibling->f_type.f_char)
+    && sibling->f_type.f_char == lc->f_type.f_char)
+    {
+        block * head(const_cast<block *>(lc->list_head()));
+        sibling->f_list_head = head->shared_from_this();
+        head->f_list_tail = sibling;
+        head->f_list_empty_lines += sibling->f_list_empty_lines;
+        sibling->f_list_tail.reset();
+        sibling->f_list_empty_lines = 0;
+    }
 }
 
 
@@ -986,6 +1153,29 @@ block::pointer_t block::unlink()
     f_previous.reset();
     f_parent.reset();
 
+    // the lists around this block changed, fix their information
+    //
+    if(is_list_item_type(f_type.f_char))
+    {
+        f_list_head.reset();
+        f_list_tail.reset();
+        f_list_empty_lines = f_followed_by_an_empty_line ? 1 : 0;
+    }
+    if(p != nullptr
+    && is_list_item_type(p->f_type.f_char))
+    {
+        index_list(const_cast<block *>(p->list_head())->shared_from_this());
+    }
+    if(n != nullptr
+    && is_list_item_type(n->f_type.f_char)
+    && (p == nullptr
+        || n->f_type.f_char != p->f_type.f_char))
+    {
+        // the next item is not part of the list of the previous item
+        //
+        index_list(n);
+    }
+
     return n != nullptr
             ? n
             : (p != nullptr
@@ -1060,6 +1250,40 @@ std::string block::tree() const
 
 
 std::string block::to_string(int indentation, bool children) const
+{
+    std::string output(node_to_string(indentation));
+
+    if(children)
+    {
+        // walk the children using an explicit stack so very deep trees
+        // can't overflow the stack; each entry is the next sibling to
+        // output at that level
+        //
+        std::vector<std::pair<pointer_t, int>> stack;
+        stack.reserve(32);
+        stack.emplace_back(f_first_child, indentation + 2);
+        while(!stack.empty())
+        {
+            auto & top(stack.back());
+            if(top.first == nullptr)
+            {
+                stack.pop_back();
+                continue;
+            }
+            pointer_t const b(top.first);
+            int const level(top.second);
+            top.first = b->f_next;
+
+            output += b->node_to_string(level);
+            stack.emplace_back(b->f_first_child, level + 2);
+        }
+    }
+
+    return output;
+}
+
+
+std::string block::node_to_string(int indentation) const
 {
     std::string indent(indentation, ' ');
     std::string output;
@@ -1214,16 +1438,6 @@ std::string block::to_string(int indentation, bool children) const
         output += "  - Block is followed by at least one empty line\n";
     }
 
-    if(children)
-    {
-        for(auto b(f_first_child);
-            b != nullptr;
-            b = b->f_next)
-        {
-            output += b->to_string(indentation + 2, true);
-        }
-    }
-
     return output;
 }
 
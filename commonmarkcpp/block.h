@@ -67,6 +67,7 @@ constexpr char32_t const    BLOCK_TYPE_HEADER_DOUBLE = U'=';
 constexpr char32_t const    BLOCK_TYPE_BREAK_DASH = U'\x2022'; // bullet point (cicle)
 constexpr char32_t const    BLOCK_TYPE_BREAK_ASTERISK = U'\x2023'; // bullet point (triangle)
 constexpr char32_t const    BLOCK_TYPE_BREAK_UNDERLINE = U'\x2024'; // bullet point (small circle)
+constexpr char32_t const    BLOCK_TYPE_EXTENSION = U'\x2699'; // gear (HTML from a block extension)
 
 
 
@@ -82,6 +83,7 @@ public:
     typedef std::weak_ptr<block>        weak_t;
 
                             block(character const & type);
+                            ~block();
 
     character               type() const;
     bool                    is_document() const;
@@ -137,6 +139,10 @@ public:
     std::string             to_string(int indentation = 0, bool children = false) const;
 
 private:
+    std::string             node_to_string(int indentation) const;
+    block const *           list_head() const;
+    static void             index_list(pointer_t head);
+
     pointer_t               f_next = pointer_t();
     weak_t                  f_previous = weak_t();
     weak_t                  f_parent = weak_t();
@@ -149,6 +155,12 @@ private:
     character::string_t     f_info_string = character::string_t();
     int                     f_number = -1;
     bool                    f_followed_by_an_empty_line = false;
+
+    // list information, only valid on list items
+    //
+    weak_t                  f_list_head = weak_t();     // first item of the list (unless this is the first item)
+    weak_t                  f_list_tail = weak_t();     // first item only: last item of the list
+    std::uint32_t           f_list_empty_lines = 0;     // first item only: number of items followed by an empty line
 };
 
 
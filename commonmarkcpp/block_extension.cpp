@@ -0,0 +1,148 @@
+// Copyright (c) 2021-2022  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/commonmarkcpp
+// contact@m2osw.com
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+/** \file
+ * \brief Implementation of the block_extension class.
+ *
+ * The block_extension is the base class of all the block extensions.
+ * It holds the list of characters which trigger a call to the convert()
+ * function of the extension.
+ */
+
+// self
+//
+#include    "commonmarkcpp/block_extension.h"
+
+#include    "commonmarkcpp/exception.h"
+
+
+// C++ lib
+//
+#include    <typeinfo>
+
+
+// last include
+//
+#include    <snapdev/poison.h>
+
+
+
+namespace cm
+{
+
+
+
+/** \brief Initialize the extension with its trigger characters.
+ *
+ * The \p triggers string lists the characters which may start the block
+ * supported by this extension. The block parser calls the convert()
+ * function only for top-level lines starting with one of those
+ * characters. Lines inside a blockquote or a list item are not offered
+ * to the extensions.
+ *
+ * Only visible ASCII characters (0x21 to 0x7E) can be used as triggers.
+ *
+ * \exception commonmark_out_of_range
+ * This exception is raised if \p triggers is empty or includes a character
+ * which is not a visible ASCII character.
+ *
+ * \param[in] triggers  The characters which start this extension blocks.
+ */
+block_extension::block_extension(std::string const & triggers)
+    : f_triggers(triggers)
+{
+    if(f_triggers.empty())
+    {
+        throw commonmark_out_of_range("a block extension needs at least one trigger character.");
+    }
+    for(auto const c : f_triggers)
+    {
+        if(c < 0x21 || c > 0x7E)
+        {
+            throw commonmark_out_of_range("block extension trigger characters must be visible ASCII characters.");
+        }
+    }
+}
+
+
+block_extension::~block_extension()
+{
+}
+
+
+/** \brief Get the trigger characters of this extension.
+ *
+ * \return The string of characters passed to the constructor.
+ */
+std::string const & block_extension::triggers() const
+{
+    return f_triggers;
+}
+
+
+/** \brief Get a string identifying this extension.
+ *
+ * The identity is used to compute the fingerprint of a commonmark object
+ * (see commonmark::fingerprint()). The default is the name of the type
+ * of the extension followed by its trigger characters.
+ *
+ * An extension which accepts options changing its output must override
+ * this function and add those options to the identity so different
+ * settings give different fingerprints.
+ *
+ * \return A string identifying this extension and its settings.
+ */
+std::string block_extension::identity() const
+{
+    return std::string(typeid(*this).name()) + ':' + f_triggers;
+}
+
+
+/** \fn block_extension::convert(character::string_t const & line, character::string_t::const_iterator it, get_line_t get_line, std::string & result)
+ * \brief Convert the block found at \p it.
+ *
+ * This function is called with \p it pointing to one of the trigger
+ * characters at the start of a line. If the line starts a block
+ * supported by the extension, the function appends the HTML of the
+ * whole block to \p result and returns true. The HTML is output
+ * verbatim, like an HTML block, so it should end with a line feed.
+ *
+ * A block can span multiple lines. Call \p get_line to read the next
+ * line of input in \p line (which is a reference to the parser's
+ * current line; \p it is not valid anymore after that call). It
+ * returns false once the end of the input is reached. The line reached
+ * when returning true is considered part of the block. The lines are
+ * given as is: since the extensions are only called at the top level,
+ * there are no container marks to remove.
+ *
+ * Otherwise the function returns false and the parser restores the
+ * input and tries the next extension or the default block starters.
+ *
+ * \param[in] line  The line being parsed.
+ * \param[in] it  The position of the trigger character in \p line.
+ * \param[in] get_line  Function to call to read the next line.
+ * \param[out] result  The string where the HTML gets appended.
+ *
+ * \return true if the extension converted the block.
+ */
+
+
+
+} // namespace cm
+// vim: ts=4 sw=4 et
@@ -0,0 +1,81 @@
+// Copyright (c) 2021-2022  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/commonmarkcpp
+// contact@m2osw.com
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+#pragma once
+
+/** \file
+ * \brief Declaration of the block_extension class.
+ *
+ * A block extension adds support for a new block syntax (admonitions,
+ * custom containers, etc.) to the block parser. Each extension declares
+ * the characters which may start its syntax so the parser only calls it
+ * for top-level lines starting with one of those characters.
+ */
+
+
+// self
+//
+#include    "commonmarkcpp/character.h"
+
+
+// C++ lib
+//
+#include    <functional>
+#include    <memory>
+#include    <string>
+#include    <vector>
+
+
+
+namespace cm
+{
+
+
+
+class block_extension
+{
+public:
+    typedef std::shared_ptr<block_extension>
+                            pointer_t;
+
+    typedef std::vector<pointer_t>
+                            vector_t;
+
+    typedef std::function<bool ()>
+                            get_line_t;
+
+                            block_extension(std::string const & triggers);
+    virtual                 ~block_extension();
+
+    std::string const &     triggers() const;
+    virtual std::string     identity() const;
+
+    virtual bool            convert(
+                                  character::string_t const & line
+                                , character::string_t::const_iterator it
+                                , get_line_t get_line
+                                , std::string & result) = 0;
+
+private:
+    std::string const       f_triggers;
+};
+
+
+
+} // namespace cm
+// vim: ts=4 sw=4 et
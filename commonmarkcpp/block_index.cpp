@@ -0,0 +1,367 @@
+// Copyright (c) 2021-2022  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/commonmarkcpp
+// contact@m2osw.com
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+/** \file
+ * \brief Implementation of the block_index class.
+ *
+ * The block index is a list of entries, one per top-level block found
+ * in a document. Each entry holds the byte offset and line number at
+ * which the block starts. Since link reference definitions can appear
+ * anywhere in a document and be used by any block, the index also saves
+ * all the references so a block can be rendered on its own.
+ *
+ * The index can be serialized in a compact binary buffer which you can
+ * save along the document and reload later.
+ */
+
+// self
+//
+#include    "commonmarkcpp/block_index.h"
+
+#include    "commonmarkcpp/exception.h"
+
+
+// C++ lib
+//
+#include    <cstring>
+
+
+// last include
+//
+#include    <snapdev/poison.h>
+
+
+
+namespace cm
+{
+
+
+
+namespace
+{
+
+
+
+// the binary format is:
+//
+//      magic               4 characters ("CMBI")
+//      version             4 bytes
+//      input size          4 bytes
+//      entry count         4 bytes
+//      [
+//      offset              4 bytes
+//      line                4 bytes
+//      type                4 bytes
+//      ]*  repeat for each entry (`entry count` times)
+//      reference count     4 bytes
+//      [
+//      name                4 bytes size + UTF-8 string
+//      destination         4 bytes size + UTF-8 string
+//      title               4 bytes size + UTF-8 string
+//      ]*  repeat for each reference (`reference count` times)
+//
+// numbers are saved in the endianness of the machine
+//
+constexpr char const        g_magic[4] = { 'C', 'M', 'B', 'I' };
+constexpr std::uint32_t     g_version = 1;
+
+
+void write_uint32(std::string & out, std::uint32_t value)
+{
+    out.append(reinterpret_cast<char const *>(&value), sizeof(value));
+}
+
+
+void write_string(std::string & out, std::string const & s)
+{
+    write_uint32(out, static_cast<std::uint32_t>(s.length()));
+    out += s;
+}
+
+
+bool read_uint32(std::string const & in, std::string::size_type & pos, std::uint32_t & value)
+{
+    if(pos + sizeof(value) > in.length())
+    {
+        return false;
+    }
+    memcpy(&value, in.data() + pos, sizeof(value));
+    pos += sizeof(value);
+    return true;
+}
+
+
+bool read_string(std::string const & in, std::string::size_type & pos, std::string & s)
+{
+    std::uint32_t size(0);
+    if(!read_uint32(in, pos, size)
+    || pos + size > in.length())
+    {
+        return false;
+    }
+    s = in.substr(pos, size);
+    pos += size;
+    return true;
+}
+
+
+
+}
+// no name namespace
+
+
+
+/** \brief Reset the index.
+ *
+ * This function removes all the entries and references from this index.
+ */
+void block_index::clear()
+{
+    f_entries.clear();
+    f_references.clear();
+    f_input_size = 0;
+}
+
+
+/** \brief Add one entry to the index.
+ *
+ * The entries are expected to be added in order (i.e. each entry
+ * offset is larger than the previous entry offset).
+ *
+ * \exception commonmark_logic_error
+ * If the new entry offset is smaller than the offset of the last entry,
+ * this exception is raised.
+ *
+ * \param[in] e  The entry to add.
+ */
+void block_index::add_entry(entry_t const & e)
+{
+    if(!f_entries.empty()
+    && e.f_offset < f_entries.back().f_offset)
+    {
+        throw commonmark_logic_error("block index entries must be added in order.");
+    }
+
+    f_entries.push_back(e);
+}
+
+
+/** \brief Get the number of entries in this index.
+ *
+ * Each entry represents one top-level block. Note that a run of list
+ * items is viewed as one block since it generates a single list in
+ * the output.
+ *
+ * \return The number of entries in the index.
+ */
+std::size_t block_index::size() const
+{
+    return f_entries.size();
+}
+
+
+/** \brief Retrieve entry \p idx.
+ *
+ * \exception commonmark_out_of_range
+ * If \p idx is too large, this exception is raised.
+ *
+ * \param[in] idx  The index of the entry to retrieve.
+ *
+ * \return A reference to the entry.
+ */
+block_index::entry_t const & block_index::entry(std::size_t idx) const
+{
+    if(idx >= f_entries.size())
+    {
+        throw commonmark_out_of_range("index out of range to retrieve a block index entry");
+    }
+
+    return f_entries[idx];
+}
+
+
+/** \brief Save the size of the input document.
+ *
+ * The last block ends at the end of the document. This size is used to
+ * know where that end is.
+ *
+ * \param[in] size  The size of the input in bytes.
+ */
+void block_index::input_size(std::uint32_t size)
+{
+    f_input_size = size;
+}
+
+
+std::uint32_t block_index::input_size() const
+{
+    return f_input_size;
+}
+
+
+/** \brief Get the byte offset where block \p idx ends.
+ *
+ * A block ends where the next block starts. The last block ends at the
+ * end of the input.
+ *
+ * \param[in] idx  The index of the entry.
+ *
+ * \return The offset just after the last byte of the block.
+ */
+std::uint32_t block_index::end_offset(std::size_t idx) const
+{
+    if(idx + 1 >= f_entries.size())
+    {
+        return f_input_size;
+    }
+
+    return f_entries[idx + 1].f_offset;
+}
+
+
+void block_index::add_reference(reference_t const & r)
+{
+    f_references.push_back(r);
+}
+
+
+block_index::reference_t::vector_t const & block_index::references() const
+{
+    return f_references;
+}
+
+
+/** \brief Convert the index to a binary buffer.
+ *
+ * This function saves the index in a compact binary format. The result
+ * can be saved to file and reloaded with the unserialize() function.
+ *
+ * \return The index in a binary buffer.
+ */
+std::string block_index::serialize() const
+{
+    std::string result;
+    result.reserve(4 * 4 + f_entries.size() * 3 * 4);
+
+    result.append(g_magic, sizeof(g_magic));
+    write_uint32(result, g_version);
+    write_uint32(result, f_input_size);
+
+    write_uint32(result, static_cast<std::uint32_t>(f_entries.size()));
+    for(auto const & e : f_entries)
+    {
+        write_uint32(result, e.f_offset);
+        write_uint32(result, e.f_line);
+        write_uint32(result, static_cast<std::uint32_t>(e.f_type));
+    }
+
+    write_uint32(result, static_cast<std::uint32_t>(f_references.size()));
+    for(auto const & r : f_references)
+    {
+        write_string(result, r.f_name);
+        write_string(result, r.f_destination);
+        write_string(result, r.f_title);
+    }
+
+    return result;
+}
+
+
+/** \brief Reload an index from a binary buffer.
+ *
+ * This function replaces this index with the one found in \p data.
+ * The \p data buffer must have been created by serialize().
+ *
+ * If the buffer is not valid, the function returns false and the
+ * index is left empty.
+ *
+ * \param[in] data  The binary buffer to load.
+ *
+ * \return true if the buffer was valid and the index loaded.
+ */
+bool block_index::unserialize(std::string const & data)
+{
+    clear();
+
+    if(data.length() < sizeof(g_magic)
+    || memcmp(data.data(), g_magic, sizeof(g_magic)) != 0)
+    {
+        return false;
+    }
+
+    std::string::size_type pos(sizeof(g_magic));
+    std::uint32_t version(0);
+    std::uint32_t count(0);
+    if(!read_uint32(data, pos, version)
+    || version != g_version
+    || !read_uint32(data, pos, f_input_size)
+    || !read_uint32(data, pos, count))
+    {
+        clear();
+        return false;
+    }
+
+    for(std::uint32_t idx(0); idx < count; ++idx)
+    {
+        entry_t e;
+        std::uint32_t type(0);
+        if(!read_uint32(data, pos, e.f_offset)
+        || !read_uint32(data, pos, e.f_line)
+        || !read_uint32(data, pos, type)
+        || e.f_offset > f_input_size
+        || (!f_entries.empty() && e.f_offset < f_entries.back().f_offset))
+        {
+            clear();
+            return false;
+        }
+        e.f_type = static_cast<char32_t>(type);
+        f_entries.push_back(e);
+    }
+
+    if(!read_uint32(data, pos, count))
+    {
+        clear();
+        return false;
+    }
+    for(std::uint32_t idx(0); idx < count; ++idx)
+    {
+        reference_t r;
+        if(!read_string(data, pos, r.f_name)
+        || !read_string(data, pos, r.f_destination)
+        || !read_string(data, pos, r.f_title))
+        {
+            clear();
+            return false;
+        }
+        f_references.push_back(r);
+    }
+
+    if(pos != data.length())
+    {
+        clear();
+        return false;
+    }
+
+    return true;
+}
+
+
+
+} // namespace cm
+// vim: ts=4 sw=4 et
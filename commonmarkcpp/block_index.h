@@ -0,0 +1,94 @@
+// Copyright (c) 2021-2022  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/commonmarkcpp
+// contact@m2osw.com
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+#pragma once
+
+/** \file
+ * \brief Declaration of the block_index class.
+ *
+ * The block index records where each top-level block starts in the
+ * input document. It can be saved and later used to render a range of
+ * blocks without having to parse the blocks that appear before.
+ */
+
+
+// C++ lib
+//
+#include    <cstdint>
+#include    <memory>
+#include    <string>
+#include    <vector>
+
+
+
+namespace cm
+{
+
+
+
+class block_index
+{
+public:
+    typedef std::shared_ptr<block_index>
+                            pointer_t;
+
+    struct entry_t
+    {
+        typedef std::vector<entry_t>        vector_t;
+
+        std::uint32_t       f_offset = 0;       // byte offset of the first line
+        std::uint32_t       f_line = 1;         // line number of the first line
+        char32_t            f_type = U'\0';     // BLOCK_TYPE_...
+    };
+
+    struct reference_t
+    {
+        typedef std::vector<reference_t>    vector_t;
+
+        std::string         f_name = std::string();
+        std::string         f_destination = std::string();
+        std::string         f_title = std::string();
+    };
+
+    void                    clear();
+
+    void                    add_entry(entry_t const & e);
+    std::size_t             size() const;
+    entry_t const &         entry(std::size_t idx) const;
+
+    void                    input_size(std::uint32_t size);
+    std::uint32_t           input_size() const;
+    std::uint32_t           end_offset(std::size_t idx) const;
+
+    void                    add_reference(reference_t const & r);
+    reference_t::vector_t const &
+                            references() const;
+
+    std::string             serialize() const;
+    bool                    unserialize(std::string const & data);
+
+private:
+    entry_t::vector_t       f_entries = entry_t::vector_t();
+    reference_t::vector_t   f_references = reference_t::vector_t();
+    std::uint32_t           f_input_size = 0;
+};
+
+
+
+} // namespace cm
+// vim: ts=4 sw=4 et
@@ -40,6 +40,8 @@
 #include    "commonmarkcpp/commonmark.h"
 
 #include    "commonmarkcpp/commonmark_entities.h"
+#include    "commonmarkcpp/metrics.h"
+#include    "commonmarkcpp/streaming_hash.h"
 
 
 // snapdev
@@ -51,12 +53,21 @@
 // C++
 //
 #include    <algorithm>
+#include    <array>
+#include    <chrono>
 #include    <cstring>
+#include    <fstream>
 #include    <iostream>
 #include    <limits>
 #include    <sstream>
 
 
+// C
+//
+#include    <errno.h>
+#include    <sys/stat.h>
+
+
 // last include
 //
 #include    <snapdev/poison.h>
@@ -183,6 +194,61 @@ bool parse_link_text(
 }
 
 
+/** \brief Check whether \p label can be the label of a link reference.
+ *
+ * A link label is at most 999 characters, it includes at least one
+ * character other than a blank and it cannot include unescaped square
+ * brackets. The \p label is expected to come from parse_link_text()
+ * so the escaped characters are still preceded by their backslash.
+ *
+ * \param[in] label  The label to check.
+ *
+ * \return true if \p label is a valid link label.
+ */
+bool is_link_label(std::string const & label)
+{
+    std::size_t length(0);
+    bool blank(true);
+    for(std::string::size_type idx(0); idx < label.length(); ++idx)
+    {
+        switch(label[idx])
+        {
+        case ' ':
+        case '\t':
+        case '\n':
+        case '\r':
+            break;
+
+        case '[':
+        case ']':
+            return false;
+
+        case '\\':
+            // an escaped bracket is fine
+            //
+            blank = false;
+            if(idx + 1 < label.length())
+            {
+                ++idx;
+                ++length;
+            }
+            break;
+
+        default:
+            blank = false;
+            break;
+
+        }
+        if((label[idx] & 0xC0) != 0x80)
+        {
+            ++length;
+        }
+    }
+
+    return !blank && length <= 999;
+}
+
+
 bool parse_link_destination(
       character::string_t line
     , character::string_t::const_iterator & it
@@ -519,10 +585,10 @@ std::cerr << "--- code = [" << static_cast<int>(code) << "] -- "
                 , name
                 , [](entity_t const & ent, std::string const & n)
                     {
-                        return ent.f_name < n;
+                        return entity_name(ent) < n;
                     }));
             if(entity == end
-            || name != entity->f_name)
+            || name != entity_name(*entity))
             {
                 valid = false;
                 name += ';';
@@ -535,12 +601,12 @@ std::cerr << "--- code = [" << static_cast<int>(code) << "] -- "
             {
                 // f_codes is already a UTF-8 string
                 //
-                result += entity->f_codes;
+                result += entity_codes(*entity);
 std::cerr << "results name = ["
 << name
 << "] and codes = ";
 bool first(true);
-for(char const * s(entity->f_codes); *s != '\0'; ++s)
+for(char const * s(entity_codes(*entity)); *s != '\0'; ++s)
 {
 if(first)
 {
@@ -734,364 +800,2078 @@ std::cerr << "URI converted: " << result << "\n";
 }
 
 
-enum class state_t
+/** \brief The attributes found by verify_tag_attributes().
+ *
+ * The iterators point in the line passed to verify_tag_attributes().
+ * The value does not include the quotes.
+ */
+struct tag_attribute_t
+{
+    typedef std::vector<tag_attribute_t>    vector_t;
+
+    character::string_t::const_iterator     f_name_start = character::string_t::const_iterator();
+    character::string_t::const_iterator     f_name_end = character::string_t::const_iterator();
+    character::string_t::const_iterator     f_value_start = character::string_t::const_iterator();
+    character::string_t::const_iterator     f_value_end = character::string_t::const_iterator();
+    bool                                    f_has_value = false;
+};
+
+
+struct tag_details_t
+{
+    tag_attribute_t::vector_t               f_attributes = tag_attribute_t::vector_t();
+    bool                                    f_self_closing = false;
+};
+
+
+/** \brief States of the tag attributes automaton.
+ *
+ * The STATE_ACCEPT and STATE_REJECT states are final.
+ */
+enum tag_state_t : std::uint8_t
 {
     STATE_NAME_OR_END,                      // attribute name or ">" or "/"
+    STATE_NAME,                             // within an attribute name
     STATE_NAME_OR_EQUAL_OR_END,             // attribute name or "=" or ">" or "/"
-    STATE_EQUAL_OR_END,                     // "=" or ">" or "/"
     STATE_ATTRIBUTE_VALUE,                  // "..." or '...' or <value>
-    STATE_ATTRIBUTE_VALUE_SINGLE_QUOTED,    // the ... in "..."
-    STATE_ATTRIBUTE_VALUE_DOUBLE_QUOTED,    // the ... in '...'
+    STATE_ATTRIBUTE_VALUE_UNQUOTED,         // within <value>
+    STATE_ATTRIBUTE_VALUE_DOUBLE_QUOTED,    // the ... in "..."
+    STATE_ATTRIBUTE_VALUE_SINGLE_QUOTED,    // the ... in '...'
     STATE_END,                              // ">"
+
+    STATE_ACCEPT,
+    STATE_REJECT,
+
+    STATE_COUNT = STATE_ACCEPT
 };
 
-bool verify_tag_attributes(
-      character::string_t const & line
-    , character::string_t::const_iterator & et)
+
+/** \brief Classes of characters of the tag attributes automaton.
+ *
+ * All the characters of one class have the same transitions in all the
+ * states. Characters outside of the ASCII range are all in the
+ * CLASS_OTHER class.
+ */
+enum tag_class_t : std::uint8_t
 {
-    state_t state(state_t::STATE_NAME_OR_END);
-    for(;;)
-    {
-void const * it_ptr(reinterpret_cast<void const *>(&*et));
-if(it_ptr < reinterpret_cast<void const *>(&*line.cbegin())
-|| it_ptr > reinterpret_cast<void const *>(&*line.cend()))
+    CLASS_BLANK,                            // space, tab
+    CLASS_FIRST_ATTRIBUTE,                  // letters, '_', ':'
+    CLASS_ATTRIBUTE,                        // digits, '-', '.'
+    CLASS_SLASH,                            // '/'
+    CLASS_EQUAL,                            // '='
+    CLASS_CLOSE_ANGLE_BRACKET,              // '>'
+    CLASS_QUOTE,                            // '"'
+    CLASS_APOSTROPHE,                       // '\''
+    CLASS_NOT_VALUE,                        // '<', '`'
+    CLASS_OTHER,                            // anything else
+
+    CLASS_COUNT
+};
+
+
+constexpr std::array<std::uint8_t, 128> build_tag_classes()
 {
-    throw commonmark_logic_error("invalid it from verify_tag_attributes()?");
+    std::array<std::uint8_t, 128> classes{};
+    for(auto & c : classes)
+    {
+        c = CLASS_OTHER;
+    }
+    for(char32_t c(U'a'); c <= U'z'; ++c)
+    {
+        classes[c] = CLASS_FIRST_ATTRIBUTE;
+        classes[c - 0x20] = CLASS_FIRST_ATTRIBUTE;
+    }
+    for(char32_t c(U'0'); c <= U'9'; ++c)
+    {
+        classes[c] = CLASS_ATTRIBUTE;
+    }
+    classes[CHAR_UNDERSCORE] = CLASS_FIRST_ATTRIBUTE;
+    classes[CHAR_COLON] = CLASS_FIRST_ATTRIBUTE;
+    classes[CHAR_DASH] = CLASS_ATTRIBUTE;
+    classes[CHAR_PERIOD] = CLASS_ATTRIBUTE;
+    classes[CHAR_SPACE] = CLASS_BLANK;
+    classes[CHAR_TAB] = CLASS_BLANK;
+    classes[CHAR_SLASH] = CLASS_SLASH;
+    classes[CHAR_EQUAL] = CLASS_EQUAL;
+    classes[CHAR_CLOSE_ANGLE_BRACKET] = CLASS_CLOSE_ANGLE_BRACKET;
+    classes[CHAR_QUOTE] = CLASS_QUOTE;
+    classes[CHAR_APOSTROPHE] = CLASS_APOSTROPHE;
+    classes[CHAR_OPEN_ANGLE_BRACKET] = CLASS_NOT_VALUE;
+    classes[CHAR_GRAVE] = CLASS_NOT_VALUE;
+    return classes;
 }
-std::cerr << " ---- tag innards state: " << static_cast<int>(state)
-<< " for [" << character::string_t(et, line.cend()) << "]...\n";
 
-        if(et == line.cend())
-        {
-            // TODO: this is currently always true here; it may be that
-            //       there are other cases where it could be otherwise?
-            //
-std::cerr << " ---- EOL found, tag needs to be complete...\n";
-            return false;
-        }
 
-        if(state == state_t::STATE_END)
-        {
-            if(et->is_close_angle_bracket())
-            {
-                // tag is considered valid
-                //
-std::cerr << " ---- tag innards got '>'\n";
-                ++et;
-                return true;
-            }
+typedef std::array<std::array<std::uint8_t, CLASS_COUNT>, STATE_COUNT>
+                                tag_transitions_t;
 
-            // TODO: restore input state (especially if we read new lines...)
-            //
-std::cerr << " ---- tag innards expect missing '>'\n";
-            return false;
-        }
 
-        if(et->is_blank())
+constexpr tag_transitions_t build_tag_transitions()
+{
+    tag_transitions_t t{};
+    for(auto & state : t)
+    {
+        for(auto & next : state)
         {
-std::cerr << " ---- tag innards skip blank\n";
-            ++et;
-            continue;
+            next = STATE_REJECT;
         }
+    }
+
+    t[STATE_NAME_OR_END][CLASS_BLANK] = STATE_NAME_OR_END;
+    t[STATE_NAME_OR_END][CLASS_FIRST_ATTRIBUTE] = STATE_NAME;
+    t[STATE_NAME_OR_END][CLASS_SLASH] = STATE_END;
+    t[STATE_NAME_OR_END][CLASS_CLOSE_ANGLE_BRACKET] = STATE_ACCEPT;
+
+    t[STATE_NAME_OR_EQUAL_OR_END] = t[STATE_NAME_OR_END];
+    t[STATE_NAME_OR_EQUAL_OR_END][CLASS_BLANK] = STATE_NAME_OR_EQUAL_OR_END;
+    t[STATE_NAME_OR_EQUAL_OR_END][CLASS_EQUAL] = STATE_ATTRIBUTE_VALUE;
+
+    // the end of a name is handled as in STATE_NAME_OR_EQUAL_OR_END
+    //
+    t[STATE_NAME] = t[STATE_NAME_OR_EQUAL_OR_END];
+    t[STATE_NAME][CLASS_FIRST_ATTRIBUTE] = STATE_NAME;
+    t[STATE_NAME][CLASS_ATTRIBUTE] = STATE_NAME;
+
+    // an unquoted value can be empty when followed by '>'
+    //
+    t[STATE_ATTRIBUTE_VALUE][CLASS_BLANK] = STATE_ATTRIBUTE_VALUE;
+    t[STATE_ATTRIBUTE_VALUE][CLASS_QUOTE] = STATE_ATTRIBUTE_VALUE_DOUBLE_QUOTED;
+    t[STATE_ATTRIBUTE_VALUE][CLASS_APOSTROPHE] = STATE_ATTRIBUTE_VALUE_SINGLE_QUOTED;
+    t[STATE_ATTRIBUTE_VALUE][CLASS_FIRST_ATTRIBUTE] = STATE_ATTRIBUTE_VALUE_UNQUOTED;
+    t[STATE_ATTRIBUTE_VALUE][CLASS_ATTRIBUTE] = STATE_ATTRIBUTE_VALUE_UNQUOTED;
+    t[STATE_ATTRIBUTE_VALUE][CLASS_SLASH] = STATE_ATTRIBUTE_VALUE_UNQUOTED;
+    t[STATE_ATTRIBUTE_VALUE][CLASS_OTHER] = STATE_ATTRIBUTE_VALUE_UNQUOTED;
+    t[STATE_ATTRIBUTE_VALUE][CLASS_CLOSE_ANGLE_BRACKET] = STATE_ACCEPT;
+
+    t[STATE_ATTRIBUTE_VALUE_UNQUOTED][CLASS_BLANK] = STATE_NAME_OR_END;
+    t[STATE_ATTRIBUTE_VALUE_UNQUOTED][CLASS_FIRST_ATTRIBUTE] = STATE_ATTRIBUTE_VALUE_UNQUOTED;
+    t[STATE_ATTRIBUTE_VALUE_UNQUOTED][CLASS_ATTRIBUTE] = STATE_ATTRIBUTE_VALUE_UNQUOTED;
+    t[STATE_ATTRIBUTE_VALUE_UNQUOTED][CLASS_SLASH] = STATE_ATTRIBUTE_VALUE_UNQUOTED;
+    t[STATE_ATTRIBUTE_VALUE_UNQUOTED][CLASS_OTHER] = STATE_ATTRIBUTE_VALUE_UNQUOTED;
+    t[STATE_ATTRIBUTE_VALUE_UNQUOTED][CLASS_CLOSE_ANGLE_BRACKET] = STATE_ACCEPT;
+
+    for(auto & next : t[STATE_ATTRIBUTE_VALUE_DOUBLE_QUOTED])
+    {
+        next = STATE_ATTRIBUTE_VALUE_DOUBLE_QUOTED;
+    }
+    t[STATE_ATTRIBUTE_VALUE_DOUBLE_QUOTED][CLASS_QUOTE] = STATE_NAME_OR_END;
+
+    for(auto & next : t[STATE_ATTRIBUTE_VALUE_SINGLE_QUOTED])
+    {
+        next = STATE_ATTRIBUTE_VALUE_SINGLE_QUOTED;
+    }
+    t[STATE_ATTRIBUTE_VALUE_SINGLE_QUOTED][CLASS_APOSTROPHE] = STATE_NAME_OR_END;
+
+    t[STATE_END][CLASS_CLOSE_ANGLE_BRACKET] = STATE_ACCEPT;
+
+    return t;
+}
+
+
+constexpr std::array<std::uint8_t, 128> const   g_tag_classes = build_tag_classes();
+constexpr tag_transitions_t const               g_tag_transitions = build_tag_transitions();
+
+
+/** \brief Verify the attributes of an HTML tag.
+ *
+ * This function runs the tag attributes automaton from \p et, which
+ * points right after the tag name, up to the closing `'>'`. Each
+ * character is mapped to a class with a table and the next state is
+ * found in the transitions table.
+ *
+ * When \p details is not nullptr, the function also saves the position
+ * of the attribute names and values and whether the tag ends with `/>`.
+ *
+ * \param[in] line  The line with the tag.
+ * \param[in,out] et  The position after the tag name. On success, the
+ * position right after the `'>'`.
+ * \param[out] details  The attributes of the tag or nullptr.
+ *
+ * \return true if the tag attributes are valid and the tag is closed.
+ */
+bool verify_tag_attributes(
+      character::string_t const & line
+    , character::string_t::const_iterator & et
+    , tag_details_t * details = nullptr)
+{
+    std::uint8_t state(STATE_NAME_OR_END);
+    for(auto it(et); it != line.cend(); ++it)
+    {
+        char32_t const c(it->f_char);
+        std::uint8_t const next(g_tag_transitions[state][c < 0x80 ? g_tag_classes[c] : static_cast<std::uint8_t>(CLASS_OTHER)]);
 
-        if(state == state_t::STATE_NAME_OR_END
-        || state == state_t::STATE_NAME_OR_EQUAL_OR_END)
+        if(details != nullptr
+        && next != state)
         {
-            if(et->is_first_attribute())
+            if(state == STATE_NAME)
             {
-                for(++et; et != line.cend(); ++et)
-                {
-                    if(!et->is_attribute())
-                    {
-                        break;
-                    }
-                }
-std::cerr << " ---- tag innards found attribute name\n";
-                state = state_t::STATE_NAME_OR_EQUAL_OR_END;
-                continue;
+                details->f_attributes.back().f_name_end = it;
             }
-            else if(et->is_slash())
+            else if(state == STATE_ATTRIBUTE_VALUE)
             {
-std::cerr << " ---- tag innards found slash\n";
-                ++et;
-                state = state_t::STATE_END;
-                continue;
+                details->f_attributes.back().f_has_value = true;
+                details->f_attributes.back().f_value_start = next == STATE_ATTRIBUTE_VALUE_UNQUOTED
+                                                                || next == STATE_ACCEPT
+                                                                    ? it
+                                                                    : it + 1;
+                details->f_attributes.back().f_value_end = it;
             }
-            else if(et->is_close_angle_bracket())
+            else if(state == STATE_ATTRIBUTE_VALUE_UNQUOTED
+                 || state == STATE_ATTRIBUTE_VALUE_DOUBLE_QUOTED
+                 || state == STATE_ATTRIBUTE_VALUE_SINGLE_QUOTED)
             {
-std::cerr << " ---- tag innards found '>', valid!\n";
-                ++et;
-                return true;
+                details->f_attributes.back().f_value_end = it;
             }
-        }
-
-        if(state == state_t::STATE_NAME_OR_EQUAL_OR_END
-        && et->is_equal())
-        {
-std::cerr << " ---- tag innards got '=' before value\n";
-            state = state_t::STATE_ATTRIBUTE_VALUE;
-            ++et;
-            continue;
-        }
 
-        if(state == state_t::STATE_ATTRIBUTE_VALUE)
-        {
-            if(et->is_quote())
-            {
-                state = state_t::STATE_ATTRIBUTE_VALUE_DOUBLE_QUOTED;
-                ++et;
-                continue;
-            }
-            else if(et->is_apostrophe())
+            if(next == STATE_NAME)
             {
-                state = state_t::STATE_ATTRIBUTE_VALUE_SINGLE_QUOTED;
-                ++et;
-                continue;
+                tag_attribute_t attribute;
+                attribute.f_name_start = it;
+                details->f_attributes.push_back(attribute);
             }
-            else
+            else if(next == STATE_END)
             {
-                for(;
-                    et != line.cend()
-                        && et->is_attribute_standalone_value();
-                    ++et);
-
-                if(et != line.cend()
-                && !et->is_blank()
-                && !et->is_slash()
-                && !et->is_close_angle_bracket())
-                {
-std::cerr << " ---- tag innards invalid attribute value\n";
-                    // TODO: fix input if multi-line
-                    //
-                    return false;
-                }
+                details->f_self_closing = true;
             }
-
-            state = state_t::STATE_NAME_OR_END;
-            continue;
         }
 
-        if(state == state_t::STATE_ATTRIBUTE_VALUE_DOUBLE_QUOTED)
+        switch(next)
         {
-            if(et->is_quote())
-            {
-                state = state_t::STATE_NAME_OR_END;
-            }
-
-            ++et;
-            continue;
-        }
+        case STATE_ACCEPT:
+            et = it + 1;
+            return true;
 
-        if(state == state_t::STATE_ATTRIBUTE_VALUE_SINGLE_QUOTED)
-        {
-            if(et->is_apostrophe())
-            {
-                state = state_t::STATE_NAME_OR_END;
-            }
+        case STATE_REJECT:
+            return false;
 
-            ++et;
-            continue;
         }
-
-        // state / current character mismatch, we've got an error
-        //
-        // TODO: fix input if multi-line
-        //
-        return false;
+        state = next;
     }
-}
-
-
 
+    // the tag needs to be complete on this line
+    //
+    return false;
 }
-// no name namespace
-
 
 
-
-
-
-
-/** \brief Setup the UTF-8 iterator to go through the input string data.
+/** \brief Parse an HTML opening or closing tag.
  *
- * The constructor initializes the UTF-8 iterator which we use to read
- * the characters as char32_t values. We then reconvert them to UTF-8
- * on output. This process allows us to at least fix any invalid
- * UTF-8 characters (later we also want to look at making sure it
- * is also canonicalized).
- */
-commonmark::commonmark()
-    : f_iterator(f_input)
-{
-}
-
-
-/** \brief Change the set of features.
+ * This function parses the tag found at \p et, which must point right
+ * after the `'<'`. On success, \p et points right after the `'>'`.
  *
- * The commonmark parsing and output can be tweaked in many different ways.
- * For you to control these tweaks, the library offers a features object
- * which has many flags that can be turned on or off to determine what
- * happens.
+ * \param[in] line  The line with the tag.
+ * \param[in,out] et  The position right after the `'<'`.
+ * \param[out] name  The lowercase name of the tag.
+ * \param[out] closing  Whether this is a closing tag.
+ * \param[out] details  The attributes of the tag.
  *
- * You must call this function before the process() function.
+ * \return true if a valid tag was found.
  */
-void commonmark::set_features(features const & features)
+bool parse_html_tag(
+      character::string_t const & line
+    , character::string_t::const_iterator & et
+    , std::string & name
+    , bool & closing
+    , tag_details_t & details)
 {
-    f_features = features;
-}
+    auto it(et);
+    closing = it != line.cend() && it->is_slash();
+    if(closing)
+    {
+        ++it;
+    }
+    if(it == line.cend()
+    || !it->is_first_tag())
+    {
+        return false;
+    }
 
+    name.clear();
+    for(; it != line.cend() && it->is_tag(); ++it)
+    {
+        name += static_cast<char>(it->f_char | (it->is_ascii_letter() ? 0x20 : 0));
+    }
 
-/** \brief Retrieve the current features of this commonmark object.
- *
- * This function returns the set of features as defined in the features
- * object passed to the set_features() function.
- *
- * The default is a features object without any modifications.
- *
- * \return The commonmark internal set of features.
- */
-features const & commonmark::get_features() const
-{
-    return f_features;
+    for(; it != line.cend() && it->is_blank(); ++it);
+
+    if(it == line.cend())
+    {
+        return false;
+    }
+
+    if(closing)
+    {
+        if(!it->is_close_angle_bracket())
+        {
+            return false;
+        }
+        ++it;
+    }
+    else if(!verify_tag_attributes(line, it, &details))
+    {
+        return false;
+    }
+
+    et = it;
+    return true;
 }
 
 
-/** \brief Add a link to the list of links of the commonmark object.
+/** \brief Generate a tag with only its allowed attributes.
  *
- * Each link found in the document are added to the commonmark
- * object using this function.
+ * This function rebuilds a tag found by parse_html_tag() keeping only
+ * the attributes allowed by the sanitizer and, for attributes which
+ * hold a URL, only if the URL scheme is allowed.
  *
- * \param[in] name  The name of the link (used as the label or alt=...).
- * \param[in] destination  The destination URI.
- * \param[in] title  The title (description/alternative) of the link.
- * \param[in] reference  The link was defined as a reference.
+ * \param[in] s  The sanitizer with the allowlist.
+ * \param[in] name  The lowercase name of the tag.
+ * \param[in] closing  Whether this is a closing tag.
+ * \param[in] details  The attributes of the tag.
+ * \param[in] add_space  Whether to add a space before the `'/'` of an
+ * empty tag.
+ *
+ * \return The HTML of the tag or an empty string if the tag is not allowed.
  */
-void commonmark::add_link(
-      std::string const & name
-    , std::string const & destination
-    , std::string const & title
-    , bool reference)
+std::string sanitize_tag(
+      sanitizer const & s
+    , std::string const & name
+    , bool closing
+    , tag_details_t const & details
+    , bool add_space)
 {
-    // TODO: once the libutf8 supports proper Unicode case folding
-    //       we have to remove these since the map will properly
-    //       support case insensitive strings
-    //
-    std::u32string lower(libutf8::to_u32string(name));
-    for(auto & c : lower)
+    if(!s.is_tag_allowed(name))
     {
-        if(c >= U'A' && c <= U'Z')
-        {
-            c |= 0x20;
-        }
-        else if(c == U'Α')   // Greek needs help which we don't yet have in libutf8 (it was started...) to pass the tests I do this which is terribly ugly...
+        return std::string();
+    }
+
+    std::string result(closing ? "</" : "<");
+    result += name;
+    for(auto const & a : details.f_attributes)
+    {
+        std::string attribute;
+        for(auto it(a.f_name_start); it != a.f_name_end; ++it)
         {
-            c = U'α';
+            attribute += static_cast<char>(it->f_char | (it->is_ascii_letter() ? 0x20 : 0));
         }
-        else if(c == U'Γ')
+        if(!s.is_attribute_allowed(name, attribute))
         {
-            c = U'γ';
+            continue;
         }
-        else if(c == U'Ω')
+
+        std::string value;
+        for(auto it(a.f_value_start); a.f_has_value && it != a.f_value_end; ++it)
         {
-            c = U'ω';
+            switch(it->f_char)
+            {
+            case CHAR_QUOTE:
+                value += "&quot;";
+                break;
+
+            case CHAR_OPEN_ANGLE_BRACKET:
+                value += "&lt;";
+                break;
+
+            case CHAR_CLOSE_ANGLE_BRACKET:
+                value += "&gt;";
+                break;
+
+            default:
+                value += it->to_utf8();
+                break;
+
+            }
+        }
+        if(sanitizer::is_url_attribute(attribute)
+        && !s.is_url_allowed(value))
+        {
+            continue;
+        }
+
+        result += ' ';
+        result += attribute;
+        if(a.f_has_value)
+        {
+            result += "=\"";
+            result += value;
+            result += '"';
+        }
+    }
+    if(details.f_self_closing)
+    {
+        result += add_space ? " />" : "/>";
+    }
+    else
+    {
+        result += '>';
+    }
+
+    return result;
+}
+
+
+/** \brief Sanitize the content of an HTML block.
+ *
+ * The HTML is copied to the output with the allowed tags rebuilt by
+ * sanitize_tag(). Comments are removed. Other tags, processing
+ * instructions, declarations and CDATA sections get their `'<'`
+ * escaped so they are shown as text.
+ *
+ * \param[in] html  The content of an HTML block.
+ * \param[in] s  The sanitizer with the allowlist.
+ * \param[in] add_space  Whether to add a space before the `'/'` of an
+ * empty tag.
+ *
+ * \return The sanitized HTML.
+ */
+std::string sanitize_html(
+      character::string_t const & html
+    , sanitizer const & s
+    , bool add_space)
+{
+    std::string result;
+    auto it(html.cbegin());
+    while(it != html.cend())
+    {
+        if(!it->is_open_angle_bracket())
+        {
+            result += it->to_utf8();
+            ++it;
+            continue;
+        }
+
+        ++it;
+        if(it + 2 < html.cend()
+        && it[0].is_exclamation_mark()
+        && it[1].is_dash()
+        && it[2].is_dash())
+        {
+            // skip comments
+            //
+            it += 3;
+            for(; it != html.cend(); ++it)
+            {
+                if(it + 2 < html.cend()
+                && it[0].is_dash()
+                && it[1].is_dash()
+                && it[2].is_close_angle_bracket())
+                {
+                    it += 3;
+                    break;
+                }
+            }
+            continue;
+        }
+
+        auto et(it);
+        std::string name;
+        bool closing(false);
+        tag_details_t details;
+        if(parse_html_tag(html, et, name, closing, details))
+        {
+            std::string const tag(sanitize_tag(s, name, closing, details, add_space));
+            if(!tag.empty())
+            {
+                result += tag;
+                it = et;
+                continue;
+            }
+        }
+
+        result += "&lt;";
+    }
+
+    return result;
+}
+
+
+/** \brief Get the line on which a top-level block starts.
+ *
+ * The type of a Setext heading is found on the underline so the line of
+ * the block itself is the line of the underline. The heading really starts
+ * with its content, so we use the line of the first content character
+ * when smaller.
+ *
+ * \param[in] b  The block to check.
+ *
+ * \return The line on which the block starts in the input.
+ */
+std::uint32_t block_start_line(block::pointer_t b)
+{
+    std::uint32_t start_line(b->line());
+    if(!b->content().empty()
+    && b->content().front().f_line != 0
+    && b->content().front().f_line < start_line)
+    {
+        start_line = b->content().front().f_line;
+    }
+    return start_line;
+}
+
+
+/** \brief Move \p offset to the start of line \p target_line.
+ *
+ * The line separators are ASCII characters so we can search for them
+ * directly in the UTF-8 input (they never appear within a multi-byte
+ * sequence).
+ *
+ * \param[in] input  The UTF-8 input.
+ * \param[in,out] offset  The offset of the start of line \p line.
+ * \param[in,out] line  The current line number.
+ * \param[in] target_line  The line to reach.
+ */
+void skip_lines(
+      std::string const & input
+    , std::string::size_type & offset
+    , std::uint32_t & line
+    , std::uint32_t target_line)
+{
+    while(line < target_line
+       && offset < input.length())
+    {
+        char const c(input[offset]);
+        ++offset;
+        if(c == '\r')
+        {
+            if(offset < input.length()
+            && input[offset] == '\n')
+            {
+                ++offset;
+            }
+            ++line;
+        }
+        else if(c == '\n')
+        {
+            ++line;
+        }
+    }
+}
+
+
+/** \brief Check whether one of the specified lines is blank.
+ *
+ * This function checks lines \p first to \p last (excluded) of \p input.
+ * A line is blank if it is empty or only includes spaces and tabs.
+ *
+ * \param[in] input  The UTF-8 input.
+ * \param[in] line  The line number of the first line of \p input.
+ * \param[in] first  The first line to check.
+ * \param[in] last  The line following the last line to check.
+ *
+ * \return true if at least one of the lines is blank.
+ */
+bool has_blank_line(
+      std::string const & input
+    , std::uint32_t line
+    , std::uint32_t first
+    , std::uint32_t last)
+{
+    std::string::size_type offset(0);
+    skip_lines(input, offset, line, first);
+    bool blank(true);
+    for(; line < last && offset < input.length(); ++offset)
+    {
+        switch(input[offset])
+        {
+        case ' ':
+        case '\t':
+            break;
+
+        case '\r':
+            if(offset + 1 < input.length()
+            && input[offset + 1] == '\n')
+            {
+                ++offset;
+            }
+            [[fallthrough]];
+        case '\n':
+            if(blank)
+            {
+                return true;
+            }
+            blank = true;
+            ++line;
+            break;
+
+        default:
+            blank = false;
+            break;
+
+        }
+    }
+
+    return false;
+}
+
+
+/** \brief Search for a blank line.
+ *
+ * This function searches for a blank line ending between \p offset and
+ * \p end in \p input. The line may start before \p offset.
+ *
+ * \param[in] input  The UTF-8 input.
+ * \param[in] offset  The offset where the search starts.
+ * \param[in] end  The offset where the search ends.
+ *
+ * \return true if a blank line was found.
+ */
+bool find_blank_line(
+      std::string const & input
+    , std::string::size_type offset
+    , std::string::size_type end)
+{
+    if(offset > 0
+    && offset < end
+    && input[offset - 1] == '\r'
+    && input[offset] == '\n')
+    {
+        // the "\r\n" was cut in two
+        //
+        ++offset;
+    }
+    while(offset > 0
+       && input[offset - 1] != '\n'
+       && input[offset - 1] != '\r')
+    {
+        --offset;
+    }
+
+    bool blank(true);
+    for(; offset < end; ++offset)
+    {
+        switch(input[offset])
+        {
+        case ' ':
+        case '\t':
+            break;
+
+        case '\r':
+            if(offset + 1 < end
+            && input[offset + 1] == '\n')
+            {
+                ++offset;
+            }
+            [[fallthrough]];
+        case '\n':
+            if(blank)
+            {
+                return true;
+            }
+            blank = true;
+            break;
+
+        default:
+            blank = false;
+            break;
+
+        }
+    }
+
+    return false;
+}
+
+
+/** \brief Check whether \p type is the type of a list item.
+ *
+ * \param[in] type  The type of a block.
+ *
+ * \return true if \p type is one of the BLOCK_TYPE_LIST_... types.
+ */
+bool is_list_item(char32_t type)
+{
+    switch(type)
+    {
+    case BLOCK_TYPE_LIST_ASTERISK:
+    case BLOCK_TYPE_LIST_PLUS:
+    case BLOCK_TYPE_LIST_DASH:
+    case BLOCK_TYPE_LIST_PERIOD:
+    case BLOCK_TYPE_LIST_PARENTHESIS:
+        return true;
+
+    }
+
+    return false;
+}
+
+
+/** \brief Check whether \p b continues the list of the previous block.
+ *
+ * A list is composed of a run of sibling list items of the same type.
+ *
+ * \param[in] b  The block to check.
+ *
+ * \return true if \p b is a list item following an item of the same list.
+ */
+bool continues_list(block::pointer_t b)
+{
+    char32_t const type(b->type().f_char);
+    return is_list_item(type)
+        && b->previous() != nullptr
+        && b->previous()->type().f_char == type;
+}
+
+
+/** \brief Find the last item of the list starting with \p b.
+ *
+ * \param[in] b  The first item of a list.
+ *
+ * \return The last sibling of \p b which is part of the same list.
+ */
+block::pointer_t last_list_item(block::pointer_t b)
+{
+    char32_t const type(b->type().f_char);
+    while(b->next() != nullptr
+       && b->next()->type().f_char == type)
+    {
+        b = b->next();
+    }
+    return b;
+}
+
+
+
+
+
+/** \brief Table of the ASCII characters with a meaning in inline content.
+ *
+ * The inline parser copies characters which are not in this table as is.
+ * This lets it copy whole runs of plain text in one loop instead of
+ * going through the large switch of the convert_char() function for
+ * each character.
+ *
+ * The dash and plus characters are only special when the ins/del
+ * extension is turned on. The trigger characters of the inline
+ * extensions get added by commonmark::build_inline_tables().
+ */
+typedef std::array<bool, 128>   inline_specials_t;
+typedef std::array<inline_extension::vector_t, 128>
+                                inline_triggers_t;
+
+
+constexpr inline_specials_t build_inline_specials(bool ins_del)
+{
+    inline_specials_t specials{};
+    specials[CHAR_NULL] = true;
+    specials[CHAR_TAB] = true;
+    specials[CHAR_LINE_FEED] = true;
+    specials[CHAR_SPACE] = true;
+    specials[CHAR_EXCLAMATION_MARK] = true;
+    specials[CHAR_QUOTE] = true;
+    specials[CHAR_AMPERSAND] = true;
+    specials[CHAR_ASTERISK] = true;
+    specials[CHAR_OPEN_ANGLE_BRACKET] = true;
+    specials[CHAR_CLOSE_ANGLE_BRACKET] = true;
+    specials[CHAR_OPEN_SQUARE_BRACKET] = true;
+    specials[CHAR_BACKSLASH] = true;
+    specials[CHAR_UNDERSCORE] = true;
+    specials[CHAR_GRAVE] = true;
+    if(ins_del)
+    {
+        specials[CHAR_DASH] = true;
+        specials[CHAR_PLUS] = true;
+    }
+    return specials;
+}
+
+
+constexpr inline_specials_t const   g_inline_specials = build_inline_specials(false);
+constexpr inline_specials_t const   g_inline_specials_ins_del = build_inline_specials(true);
+
+
+/** \brief Table of the ASCII characters which can start a leaf block.
+ *
+ * Once the containers are parsed, a line which does not start with one
+ * of these characters (or the trigger of a block extension) is always
+ * a paragraph line, so the parser does not need to go through each
+ * block starter function.
+ */
+constexpr std::array<bool, 128> build_block_starters()
+{
+    std::array<bool, 128> starters{};
+    starters[CHAR_HASH] = true;                     // ATX heading
+    starters[CHAR_ASTERISK] = true;                 // thematic break
+    starters[CHAR_DASH] = true;                     // thematic break or setext heading
+    starters[CHAR_OPEN_ANGLE_BRACKET] = true;       // HTML block
+    starters[CHAR_EQUAL] = true;                    // setext heading
+    starters[CHAR_OPEN_SQUARE_BRACKET] = true;      // reference definition
+    starters[CHAR_UNDERSCORE] = true;               // thematic break
+    starters[CHAR_GRAVE] = true;                    // fenced code block
+    starters[CHAR_TILDE] = true;                    // fenced code block
+    return starters;
+}
+
+
+constexpr std::array<bool, 128> const   g_block_starters = build_block_starters();
+
+
+/** \brief Flags of the plain text table.
+ *
+ * The commonmark::is_plain_text() function uses a table of 256 bytes
+ * to quickly determine whether an input includes any markup. These are
+ * the flags found in that table.
+ */
+constexpr std::uint8_t const    PLAIN_TEXT_SPECIAL = 0x01;      // may start inline markup anywhere
+constexpr std::uint8_t const    PLAIN_TEXT_LINE_START = 0x02;   // may start a block at the start of a line
+constexpr std::uint8_t const    PLAIN_TEXT_CHECK = 0x04;        // needs to be checked further
+}
+// no name namespace
+
+
+
+
+
+
+
+/** \brief Initialize the commonmark object.
+ *
+ * The input is read with a utf8_input object which gives us the
+ * characters as char32_t values. We then reconvert them to UTF-8
+ * on output. This process allows us to at least fix any invalid
+ * UTF-8 characters (later we also want to look at making sure it
+ * is also canonicalized).
+ */
+commonmark::commonmark()
+{
+    build_block_tables();
+    build_inline_tables();
+}
+
+
+/** \brief Change the set of features.
+ *
+ * The commonmark parsing and output can be tweaked in many different ways.
+ * For you to control these tweaks, the library offers a features object
+ * which has many flags that can be turned on or off to determine what
+ * happens.
+ *
+ * You must call this function before the process() function.
+ */
+void commonmark::set_features(features const & features)
+{
+    f_features = features;
+    build_inline_tables();
+}
+
+
+/** \brief Retrieve the current features of this commonmark object.
+ *
+ * This function returns the set of features as defined in the features
+ * object passed to the set_features() function.
+ *
+ * The default is a features object without any modifications.
+ *
+ * \return The commonmark internal set of features.
+ */
+features const & commonmark::get_features() const
+{
+    return f_features;
+}
+
+
+/** \brief Add an inline extension.
+ *
+ * The inline parser calls the convert() function of the extension each
+ * time it finds one of its trigger characters in inline content (i.e.
+ * not within inline code, HTML tags, etc.) When several extensions use
+ * the same trigger character, they get called in the order in which
+ * they were added until one of them accepts the input.
+ *
+ * Characters which are not used as triggers are not affected so an
+ * extension only costs something where its trigger characters appear.
+ *
+ * \exception unexpected_null_pointer
+ * This exception is raised if \p e is a null pointer.
+ *
+ * \param[in] e  The extension to add.
+ */
+void commonmark::add_inline_extension(inline_extension::pointer_t e)
+{
+    if(e == nullptr)
+    {
+        throw unexpected_null_pointer("add_inline_extension() called with a null pointer.");
+    }
+
+    f_inline_extensions.push_back(e);
+    build_inline_tables();
+}
+
+
+/** \brief Add a block extension.
+ *
+ * The block parser calls the convert() function of the extension for
+ * each top-level line which starts with one of its trigger characters.
+ * Lines found inside a container (a blockquote or a list item) are
+ * not offered to the extensions, they get parsed as usual. The
+ * extensions get called before the default block starters (fenced code
+ * blocks, HTML blocks, headers, etc.) so they can take over lines which
+ * would otherwise start one of those. When several extensions use the
+ * same trigger character, they get called in the order in which they
+ * were added until one of them accepts the line.
+ *
+ * \exception unexpected_null_pointer
+ * This exception is raised if \p e is a null pointer.
+ *
+ * \param[in] e  The extension to add.
+ */
+void commonmark::add_block_extension(block_extension::pointer_t e)
+{
+    if(e == nullptr)
+    {
+        throw unexpected_null_pointer("add_block_extension() called with a null pointer.");
+    }
+
+    f_block_extensions.push_back(e);
+    build_block_tables();
+}
+
+
+/** \brief Set the renderer of code blocks written in \p language.
+ *
+ * By default, the content of code blocks is output with the HTML special
+ * characters escaped. When a fenced code block info string starts with
+ * \p language, the \p renderer gets called instead with the raw content
+ * of the block. It is expected to save the corresponding HTML in its
+ * output parameter, for example, the code with syntax highlighting.
+ * That parameter is an empty string, not the document output.
+ * The `<pre><code class="language-...">` and `</code></pre>` tags are
+ * still output by the library around that HTML.
+ *
+ * The renderer is also given the complete info string so it can make
+ * use of additional parameters (line numbers, etc.)
+ *
+ * Setting the renderer of a language to an empty function removes it
+ * and the content of such code blocks gets escaped again.
+ *
+ * \param[in] language  The language as found in the info string.
+ * \param[in] renderer  The function used to generate the code HTML.
+ */
+void commonmark::set_code_renderer(std::string const & language, code_renderer_t renderer)
+{
+    if(renderer == nullptr)
+    {
+        f_code_renderers.erase(language);
+    }
+    else
+    {
+        f_code_renderers[language] = renderer;
+    }
+}
+
+
+/** \brief Sanitize the HTML found in the input.
+ *
+ * By default, raw HTML found in the input (HTML blocks and inline tags)
+ * is copied as is to the output. When processing untrusted content, set
+ * a sanitizer to filter that HTML as it gets generated:
+ *
+ * \li tags which are not allowed get their `'<'` escaped so they appear
+ * as text;
+ * \li attributes which are not allowed are removed from allowed tags;
+ * \li URLs in attributes and Markdown links and images are checked
+ * against the allowed schemes; attributes with other URLs are removed
+ * and links and images get an empty destination;
+ * \li HTML comments are removed.
+ *
+ * The HTML generated by block extensions and code renderers is not
+ * affected.
+ *
+ * \param[in] s  The sanitizer to use or nullptr to output raw HTML as is.
+ */
+void commonmark::set_sanitizer(sanitizer::pointer_t s)
+{
+    f_sanitizer = s;
+}
+
+
+/** \brief Set a function used to rewrite link and image destinations.
+ *
+ * The \p rewriter gets called each time the inline parser outputs a link,
+ * an autolink or an image. It receives the destination once converted by
+ * convert_uri() and can replace it (i.e. to send images to a CDN or
+ * rewrite relative paths). It can also append attributes to the tag,
+ * such as ` loading="lazy"` or the `width` and `height` of an image.
+ * The attributes must start with a space.
+ *
+ * Both strings are output as is so they must be valid HTML attribute
+ * values.
+ *
+ * \param[in] rewriter  The function used to rewrite destinations or an
+ * empty function to stop rewriting them.
+ */
+void commonmark::set_link_rewriter(link_rewriter_t rewriter)
+{
+    f_link_rewriter = rewriter;
+}
+
+
+/** \brief Use a render cache.
+ *
+ * When a render cache is set, the process() function first searches the
+ * cache using the get_cache_key() of the input. If found, the cached HTML
+ * is returned as is. Otherwise the input gets processed and the resulting
+ * HTML is saved in the cache.
+ *
+ * The cache is not used when the block index or block hashes are
+ * requested since those require the input to be parsed. When process()
+ * is called with an output sink, the cache is searched but the HTML
+ * written to the sink is not saved in the cache.
+ *
+ * The same cache can be shared by many commonmark objects and many
+ * processes. A render_cache object can also be shared between threads,
+ * although its accesses are then serialized by its mutex, so each
+ * thread may prefer to have its own render_cache object.
+ *
+ * \param[in] cache  The cache to use or nullptr to stop using a cache.
+ */
+void commonmark::set_render_cache(render_cache::pointer_t cache)
+{
+    f_render_cache = cache;
+}
+
+
+/** \brief Call a function when a document takes too long to process.
+ *
+ * When process() takes \p threshold or more to parse and generate a
+ * document, the \p hook gets called with details about that document:
+ * its size and hash, the time spent in each phase, the number of blocks
+ * and the deepest nesting of blocks. This helps find the documents
+ * responsible for latency outliers in production.
+ *
+ * If \p quarantine_directory is not empty, the input is also saved in
+ * that directory, named after its hash, so it can be replayed later (i.e.
+ * with a benchmark). The directory gets created if it does not exist.
+ * Failing to save the input is not an error; the filename in the details
+ * is then empty.
+ *
+ * Documents found in the render cache are never reported.
+ *
+ * \param[in] threshold  The minimum duration of a slow document.
+ * \param[in] hook  The function to call or nullptr to remove the hook.
+ * \param[in] quarantine_directory  Where to save the slow documents.
+ */
+void commonmark::set_slow_document_hook(
+          std::chrono::steady_clock::duration threshold
+        , slow_document_hook_t hook
+        , std::string const & quarantine_directory)
+{
+    f_slow_document_threshold = threshold;
+    f_slow_document_hook = hook;
+    f_quarantine_directory = quarantine_directory;
+}
+
+
+/** \brief Add a link to the list of links of the commonmark object.
+ *
+ * The links added with this function are available to all the documents
+ * processed with this commonmark object. The links defined by a document
+ * (i.e. link reference definitions) are only available to that one
+ * document. They get removed when the next document is processed.
+ *
+ * \param[in] name  The name of the link (used as the label or alt=...).
+ * \param[in] destination  The destination URI.
+ * \param[in] title  The title (description/alternative) of the link.
+ * \param[in] reference  The link was defined as a reference.
+ */
+void commonmark::add_link(
+      std::string const & name
+    , std::string const & destination
+    , std::string const & title
+    , bool reference)
+{
+    insert_link(f_user_links, name, destination, title, reference);
+    insert_link(f_links, name, destination, title, reference);
+}
+
+
+/** \brief Add a link to a map of links.
+ *
+ * This function adds the \p destination and \p title of link \p name
+ * to the \p links map. The name is folded so the search is case
+ * insensitive.
+ *
+ * \param[in,out] links  The map where the link gets added.
+ * \param[in] name  The name of the link (used as the label or alt=...).
+ * \param[in] destination  The destination URI.
+ * \param[in] title  The title (description/alternative) of the link.
+ * \param[in] reference  The link was defined as a reference.
+ */
+void commonmark::insert_link(
+      link::map_t & links
+    , std::string const & name
+    , std::string const & destination
+    , std::string const & title
+    , bool reference)
+{
+    // TODO: once the libutf8 supports proper Unicode case folding
+    //       we have to remove these since the map will properly
+    //       support case insensitive strings
+    //
+    std::u32string lower(libutf8::to_u32string(name));
+    for(auto & c : lower)
+    {
+        if(c >= U'A' && c <= U'Z')
+        {
+            c |= 0x20;
+        }
+        else if(c == U'Α')   // Greek needs help which we don't yet have in libutf8 (it was started...) to pass the tests I do this which is terribly ugly...
+        {
+            c = U'α';
+        }
+        else if(c == U'Γ')
+        {
+            c = U'γ';
+        }
+        else if(c == U'Ω')
+        {
+            c = U'ω';
+        }
+    }
+    std::string lname(libutf8::to_u8string(lower));
+
+    link::pointer_t l;
+    auto const it(links.find(lname));
+    if(it == links.end())
+    {
+        l = std::make_shared<link>(name);
+        links[lname] = l;
+    }
+    else
+    {
+        l = it->second;
+    }
+
+    uri u;
+    if(reference)
+    {
+        u.mark_as_reference();
+    }
+    u.destination(destination);
+    u.title(title);
+
+    l->add_uri(u);
+}
+
+
+/** \brief Remove the links defined by the previous document.
+ *
+ * The link reference definitions found in a document are added to the
+ * list of links. This function resets that list to the links added
+ * with add_link() so one document does not see the references of
+ * another.
+ *
+ * The links are copied since adding a URI to a link found in the
+ * document must not change the links added with add_link().
+ */
+void commonmark::reset_links()
+{
+    f_links.clear();
+    for(auto const & l : f_user_links)
+    {
+        f_links[l.first] = std::make_shared<link>(*l.second);
+    }
+}
+
+
+/** \brief Search for a link reference.
+ *
+ * This function returns the link reference \p name or a null pointer
+ * if the reference is not found.
+ *
+ * There is nearly no constraints on the name of a link reference.
+ * Note that in our case, the link name is not processed. It is as
+ * it appears in the source file (except that it usually get trimmed).
+ *
+ * \return A link point or nullptr.
+ */
+link::pointer_t commonmark::find_link_reference(std::string const & name)
+{
+    // TODO: once the libutf8 supports proper Unicode case folding
+    //       we have to remove these since the map will properly
+    //       support case insensitive strings
+    //
+    std::u32string lower(libutf8::to_u32string(name));
+    for(auto & c : lower)
+    {
+        if(c >= U'A' && c <= U'Z')
+        {
+            c |= 0x20;
+        }
+        else if(c == U'Α')   // Greek needs help which we don't yet have in libutf8 (it was started...) to pass the tests I do this which is terribly ugly...
+        {
+            c = U'α';
+        }
+        else if(c == U'Γ')
+        {
+            c = U'γ';
+        }
+        else if(c == U'Ω')
+        {
+            c = U'ω';
+        }
+    }
+    std::string lname(libutf8::to_u8string(lower));
+std::cerr << " --- ref: search for link named [" << lname << "]\n";
+
+    auto it(f_links.find(lname));
+    if(it == f_links.end())
+    {
+        if(f_streaming
+        && is_link_label(name))
+        {
+            // the definition may still appear later in the stream
+            //
+            f_unresolved_references.insert(lname);
+        }
+        return link::pointer_t();
+    }
+    return it->second;
+}
+
+
+/** \brief Process the specified input data.
+ *
+ * This function processes the specified \p input data and returns the
+ * resulting HTML.
+ *
+ * Each call updates the process-wide metrics (see the metrics class):
+ * the number of documents and bytes and the time spent parsing and
+ * generating the HTML.
+ *
+ * \param[in] input  The input markdown to convert to HTML.
+ *
+ * \return The resulting HTML in a UTF-8 string.
+ */
+std::string commonmark::process(std::string const & input)
+{
+    std::chrono::steady_clock::time_point const start(std::chrono::steady_clock::now());
+
+    f_input = input;
+    f_line = 1;
+    f_column = 1;
+    reset_links();
+    f_output.clear();
+    f_block_hashes.clear();
+    f_flushed_size = 0;
+    f_hashed_size = 0;
+    f_output_hash.reset();
+
+    bool const use_cache(f_render_cache != nullptr
+                      && !f_build_block_index
+                      && !f_compute_block_hashes);
+    std::uint64_t key(0);
+    if(use_cache)
+    {
+        key = get_cache_key(input);
+        if(f_render_cache->find(key, f_output))
+        {
+            metrics::add_cache_hit();
+            flush_output();
+            metrics::add_document(input.length(), f_flushed_size + f_output.length());
+            metrics::add_duration(metrics_phase_t::METRICS_PHASE_TOTAL, std::chrono::steady_clock::now() - start);
+            return f_output;
+        }
+        metrics::add_cache_miss();
+    }
+
+    std::chrono::steady_clock::time_point parsed;
+    std::chrono::steady_clock::time_point indexed;
+    if(!f_build_block_index
+    && is_plain_text(input))
+    {
+        // nothing to parse, the document is only made of paragraphs
+        //
+        f_document.reset();
+        parsed = std::chrono::steady_clock::now();
+        indexed = parsed;
+        generate_plain_text(input);
+    }
+    else
+    {
+        parse();
+        parsed = std::chrono::steady_clock::now();
+std::cerr << "- * -------------------------------------------- TREE:\n";
+std::cerr << f_document->tree();
+std::cerr << "- * -------------------------------------------- TREE END ---\n";
+        if(f_build_block_index)
+        {
+            index_blocks();
+        }
+        indexed = std::chrono::steady_clock::now();
+        generate(f_document);
+    }
+    if(use_cache
+    && f_sink == nullptr)
+    {
+        f_render_cache->store(key, f_output);
+    }
+    flush_output();
+
+    std::chrono::steady_clock::time_point const end(std::chrono::steady_clock::now());
+    metrics::add_document(input.length(), f_flushed_size + f_output.length());
+    metrics::add_duration(metrics_phase_t::METRICS_PHASE_PARSE, parsed - start);
+    metrics::add_duration(metrics_phase_t::METRICS_PHASE_GENERATE, end - indexed);
+    metrics::add_duration(metrics_phase_t::METRICS_PHASE_TOTAL, end - start);
+
+    if(f_slow_document_hook != nullptr
+    && end - start >= f_slow_document_threshold)
+    {
+        report_slow_document(input, parsed - start, end - indexed, end - start);
+    }
+
+    return f_output;
+}
+
+
+/** \brief Process the specified input data and send the HTML to a sink.
+ *
+ * This function processes the specified \p input data like the other
+ * process() function, only the resulting HTML gets written to \p sink
+ * as each top-level block is generated. The output buffer is emptied
+ * each time, so the whole HTML document is never held in memory.
+ *
+ * This is useful to compress the output while it gets generated
+ * (see the deflate_sink class).
+ *
+ * Once the document was fully generated, the finish() function of the
+ * \p sink gets called.
+ *
+ * The offsets of the block hashes are offsets in the whole HTML
+ * document, as if it had been returned in one string.
+ *
+ * \param[in] input  The input markdown to convert to HTML.
+ * \param[in] sink  The sink receiving the resulting HTML.
+ */
+void commonmark::process(std::string const & input, output_sink & sink)
+{
+    f_sink = &sink;
+    try
+    {
+        process(input);
+    }
+    catch(...)
+    {
+        f_sink = nullptr;
+        throw;
+    }
+    f_sink = nullptr;
+
+    sink.finish();
+}
+
+
+/** \brief Process a string with inline markup only.
+ *
+ * This function converts short strings such as titles, labels, or chat
+ * messages which only make use of inline markup (emphasis, code, links,
+ * etc.) It does not search for blocks at all and it does not wrap the
+ * result in a paragraph, so calling this function is much faster than
+ * calling process() and removing the `<p>` and `</p>` tags.
+ *
+ * The whole \p input is viewed as the content of one paragraph. The
+ * blanks at the start of each line are ignored and the line feeds are
+ * kept as is.
+ *
+ * Since there are no blocks, the \p input cannot define link references.
+ * Links defined with add_link() can still be referenced.
+ *
+ * The process-wide metrics are updated like with process().
+ *
+ * \param[in] input  The input markdown to convert to HTML.
+ *
+ * \return The resulting HTML in a UTF-8 string.
+ */
+std::string commonmark::process_inline(std::string const & input)
+{
+    std::chrono::steady_clock::time_point const start(std::chrono::steady_clock::now());
+
+    f_utf8_input.reset(input);
+    f_line = 1;
+    f_column = 1;
+    reset_links();
+
+    character::string_t line;
+    line.reserve(input.length());
+    bool start_of_line(true);
+    for(;;)
+    {
+        character const c(getc());
+        if(c.is_eos())
+        {
+            break;
+        }
+        if(start_of_line
+        && c.is_blank())
+        {
+            continue;
+        }
+        start_of_line = c.is_eol();
+        line += c;
+    }
+
+    f_output.clear();
+    generate_inline(line);
+
+    metrics::add_document(input.length(), f_output.length());
+    metrics::add_duration(metrics_phase_t::METRICS_PHASE_TOTAL, std::chrono::steady_clock::now() - start);
+
+    return f_output;
+}
+
+
+/** \brief Request that process() builds a block index.
+ *
+ * When this flag is set to true, the process() function saves the
+ * position of each top-level block in a block index. You can retrieve
+ * that index with get_block_index() once process() returned. It can be
+ * serialized and reused with process_blocks() to render only a few of
+ * the blocks of a very large document.
+ *
+ * By default, no index is built.
+ *
+ * \param[in] build  Whether to build the block index.
+ *
+ * \sa get_block_index()
+ * \sa process_blocks()
+ */
+void commonmark::set_build_block_index(bool build)
+{
+    f_build_block_index = build;
+}
+
+
+/** \brief Retrieve the block index.
+ *
+ * This function returns the block index built by the last call to
+ * process(). If set_build_block_index() was not called with true
+ * before calling process(), the index is empty.
+ *
+ * \return A reference to the block index.
+ */
+block_index const & commonmark::get_block_index() const
+{
+    return f_block_index;
+}
+
+
+/** \brief Process a range of blocks.
+ *
+ * This function renders \p count blocks starting at block \p first
+ * as found in \p index. The \p input must be the same document as the
+ * one used to build the index.
+ *
+ * Only the input lines of the specified blocks get parsed. The link
+ * references saved in the index are defined before parsing so links
+ * work as if the whole document had been parsed. These references are
+ * removed once done. The links added with add_link() are kept.
+ *
+ * \note
+ * The document `<div>` tag is not added around the output since the
+ * result only represents a part of the document.
+ *
+ * \exception commonmark_out_of_range
+ * The \p first and \p count parameters must define a range within the
+ * index. Also the size of \p input must match the size saved in the index.
+ *
+ * \param[in] input  The input markdown used to build \p index.
+ * \param[in] index  The block index of \p input.
+ * \param[in] first  The first block to render.
+ * \param[in] count  The number of blocks to render.
+ *
+ * \return The resulting HTML in a UTF-8 string.
+ */
+std::string commonmark::process_blocks(
+      std::string const & input
+    , block_index const & index
+    , std::size_t first
+    , std::size_t count)
+{
+    if(input.length() != index.input_size())
+    {
+        throw commonmark_out_of_range("the block index does not match this input.");
+    }
+    if(first >= index.size()
+    || count > index.size() - first)
+    {
+        throw commonmark_out_of_range("block range is out of the block index.");
+    }
+    if(count == 0)
+    {
+        return std::string();
+    }
+
+    // we also parse the block following the range (if any) so the last
+    // block we render sees the same context as in the whole document
+    //
+    std::size_t const parse_count(first + count < index.size() ? count + 1 : count);
+    block_index::entry_t const & e(index.entry(first));
+    std::uint32_t const end(index.end_offset(first + parse_count - 1));
+
+    // the references of the index are only valid for this call
+    //
+    reset_links();
+    for(auto const & r : index.references())
+    {
+        insert_link(f_links, r.f_name, r.f_destination, r.f_title, true);
+    }
+
+    f_input = input.substr(e.f_offset, end - e.f_offset);
+    f_output.clear();
+    f_block_hashes.clear();
+    f_flushed_size = 0;
+    f_hashed_size = 0;
+    f_output_hash.reset();
+    f_line = e.f_line;
+    f_column = 1;
+
+    try
+    {
+        parse();
+
+        block::pointer_t b(f_document->first_child());
+        for(std::size_t idx(0);
+            idx < count && b != nullptr;
+            ++idx, b = b->next())
+        {
+            generate_top_level_block(b);
         }
+        flush_output();
     }
-    std::string lname(libutf8::to_u8string(lower));
+    catch(...)
+    {
+        reset_links();
+        throw;
+    }
+    reset_links();
 
-    link::pointer_t l;
-    auto const it(f_links.find(lname));
-    if(it == f_links.end())
+    return f_output;
+}
+
+
+/** \brief Start processing a document as a stream.
+ *
+ * This function starts a new stream. The input is then given in chunks
+ * with add_input() and the stream ends with a call to finish().
+ *
+ * The stream mode generates the HTML of each top-level block as soon as
+ * it is complete. Since a link reference definition can appear after
+ * its use, a block making use of a reference which is not yet defined
+ * is kept as a placeholder. Its HTML gets generated again once the
+ * definition is found or is used as is when finish() gets called. The
+ * blocks following a placeholder are already generated but held back
+ * so the output remains in order.
+ *
+ * The stream mode has the following limits:
+ *
+ * \li A block using a reference which never gets defined holds back
+ * all the following blocks until finish() gets called. Only the bracket
+ * texts which are valid link labels are viewed as references.
+ * \li The last top-level block is parsed again with the next chunks
+ * since it may not be complete. A list is viewed as one block so a very
+ * long list is only returned once it ends. The same applies to a block
+ * preceded by a link reference definition without a blank line in
+ * between: the block before that definition is kept too.
+ * \li To keep the parsing linear, the pending lines are only parsed
+ * again once their size doubled (or a blank line ends a paragraph) so
+ * the HTML of a complete block may be returned a few chunks later.
+ *
+ * The hashes of blocks are not computed in stream mode.
+ *
+ * \sa add_input()
+ * \sa finish()
+ */
+void commonmark::start()
+{
+    f_streaming = true;
+    reset_links();
+    f_pending_input.clear();
+    f_pending_line = 1;
+    f_next_parse_size = 0;
+    f_pending_paragraph = false;
+    f_segments.clear();
+    f_definitions.clear();
+    f_block_hashes.clear();
+    f_flushed_size = 0;
+    f_hashed_size = 0;
+    f_output_hash.reset();
+
+    if(f_features.get_add_document_div())
+    {
+        segment_t s;
+        if(f_features.get_add_classes())
+        {
+            s.f_html = "<div class=\"cm-document\">";
+        }
+        else
+        {
+            s.f_html = "<div>";
+        }
+        f_segments.push_back(s);
+    }
+}
+
+
+/** \brief Add input to the current stream.
+ *
+ * This function adds \p input to the stream. Only complete lines get
+ * parsed. The last top-level block found so far is kept since further
+ * lines may still be added to it.
+ *
+ * The lines of that last block get parsed again with the next chunks.
+ * To avoid parsing a large block once per chunk, the pending lines are
+ * only parsed again once their size doubled, or when a blank line ends
+ * a pending paragraph. So the HTML of a block may be returned a few
+ * chunks after the block was complete.
+ *
+ * \exception commonmark_logic_error
+ * This exception is raised if start() was not called first.
+ *
+ * \param[in] input  The next chunk of input markdown.
+ *
+ * \return The HTML which is now final, possibly an empty string.
+ */
+std::string commonmark::add_input(std::string const & input)
+{
+    if(!f_streaming)
     {
-        l = std::make_shared<link>(name);
-        f_links[lname] = l;
+        throw commonmark_logic_error("add_input() called without a call to start() first.");
     }
-    else
+
+    std::string::size_type const previous_length(f_pending_input.length());
+    f_pending_input += input;
+    std::string::size_type const pos(f_pending_input.rfind('\n'));
+    if(pos == std::string::npos)
     {
-        l = it->second;
+        return std::string();
     }
 
-    uri u;
-    if(reference)
+    // the lines of the last block get parsed again along the next chunks
+    // so we wait for the pending lines to double in size before parsing
+    // them again; that way a very large block does not get parsed once
+    // per chunk (which would be O(n^2)); a blank line ends a paragraph
+    // so in that case we do not wait
+    //
+    if(pos + 1 < f_next_parse_size
+    && (!f_pending_paragraph
+        || !find_blank_line(f_pending_input, previous_length, pos + 1)))
     {
-        u.mark_as_reference();
+        return std::string();
     }
-    u.destination(destination);
-    u.title(title);
+    parse_pending_input(pos + 1, false);
+    f_next_parse_size = (pos + 1 - (previous_length + input.length() - f_pending_input.length())) * 2;
 
-    l->add_uri(u);
+    std::string result(release_segments(false));
+    if(f_compute_output_hash)
+    {
+        f_output_hash.add(result);
+    }
+
+    return result;
 }
 
 
-/** \brief Search for a link reference.
+/** \brief End the current stream.
  *
- * This function returns the link reference \p name or a null pointer
- * if the reference is not found.
+ * This function parses the remaining input and returns all the HTML
+ * not yet returned by add_input(). The references still not defined
+ * are rendered as if the whole document had been parsed at once.
  *
- * There is nearly no constraints on the name of a link reference.
- * Note that in our case, the link name is not processed. It is as
- * it appears in the source file (except that it usually get trimmed).
+ * \exception commonmark_logic_error
+ * This exception is raised if start() was not called first.
  *
- * \return A link point or nullptr.
+ * \return The remaining HTML.
  */
-link::pointer_t commonmark::find_link_reference(std::string const & name)
+std::string commonmark::finish()
 {
-    // TODO: once the libutf8 supports proper Unicode case folding
-    //       we have to remove these since the map will properly
-    //       support case insensitive strings
-    //
-    std::u32string lower(libutf8::to_u32string(name));
-    for(auto & c : lower)
+    if(!f_streaming)
     {
-        if(c >= U'A' && c <= U'Z')
+        throw commonmark_logic_error("finish() called without a call to start() first.");
+    }
+
+    parse_pending_input(f_pending_input.length(), true);
+    f_pending_input.clear();
+    f_streaming = false;
+
+    std::string result(release_segments(true));
+    if(f_features.get_add_document_div())
+    {
+        result += "</div>";
+    }
+    if(f_compute_output_hash)
+    {
+        f_output_hash.add(result);
+    }
+
+    return result;
+}
+
+
+/** \brief Parse the pending input and generate the complete blocks.
+ *
+ * This function parses the first \p size bytes of the pending input.
+ * Each complete top-level block is transformed into a segment. When
+ * \p last is false, the last top-level block (or list) is viewed as
+ * incomplete. Its input remains pending so it gets parsed again along
+ * the next chunk.
+ *
+ * Once the new blocks were added, the placeholders which reference a
+ * link now defined get generated again.
+ *
+ * \param[in] size  The number of bytes of pending input to parse.
+ * \param[in] last  Whether this is the end of the stream.
+ */
+void commonmark::parse_pending_input(std::string::size_type size, bool last)
+{
+    f_input = f_pending_input.substr(0, size);
+    f_line = f_pending_line;
+    f_column = 1;
+
+    parse();
+
+    block::pointer_t end;
+    std::uint32_t cut_line(std::numeric_limits<std::uint32_t>::max());
+    if(!last)
+    {
+        end = f_document->last_child();
+        if(end != nullptr)
         {
-            c |= 0x20;
+            for(;;)
+            {
+                while(end != nullptr
+                   && continues_list(end))
+                {
+                    end = end->previous();
+                }
+                if(end == nullptr)
+                {
+                    // nothing is complete yet
+                    //
+                    end = f_document->first_child();
+                    cut_line = f_pending_line;
+                    break;
+                }
+                cut_line = block_start_line(end);
+
+                // a definition found right before the block changes the
+                // way its first lines get parsed and so does the block
+                // before that definition; keep that block pending too so
+                // the next parse starts in the same context
+                //
+                auto d(f_definitions.rbegin());
+                while(d != f_definitions.rend()
+                   && d->f_line >= cut_line)
+                {
+                    ++d;
+                }
+                if(d == f_definitions.rend()
+                || has_blank_line(f_input, f_pending_line, d->f_line, cut_line))
+                {
+                    break;
+                }
+                end = end->previous();
+            }
         }
-        else if(c == U'Α')   // Greek needs help which we don't yet have in libutf8 (it was started...) to pass the tests I do this which is terribly ugly...
+        else if(!f_definitions.empty())
         {
-            c = U'α';
+            cut_line = f_definitions.back().f_line;
         }
-        else if(c == U'Γ')
+    }
+
+    // the definitions found before the cut are complete
+    //
+    for(auto const & d : f_definitions)
+    {
+        if(d.f_line < cut_line)
         {
-            c = U'γ';
+            insert_link(f_links, d.f_name, d.f_destination, d.f_title, true);
         }
-        else if(c == U'Ω')
+    }
+    f_definitions.clear();
+
+    for(block::pointer_t b(f_document->first_child());
+        b != end;
+        b = b->next())
+    {
+        segment_t s;
+        s.f_block = b;
+        b = generate_segment(s);
+        f_segments.push_back(s);
+    }
+
+    std::string::size_type offset(0);
+    skip_lines(f_input, offset, f_pending_line, cut_line);
+    f_pending_input.erase(0, offset);
+    f_pending_paragraph = end != nullptr
+                       && end->next() == nullptr
+                       && end->is_paragraph();
+
+    // patch the placeholders which can now be resolved
+    //
+    for(auto & s : f_segments)
+    {
+        for(auto const & name : s.f_unresolved_references)
         {
-            c = U'ω';
+            if(f_links.find(name) != f_links.end())
+            {
+                generate_segment(s);
+                break;
+            }
         }
     }
-    std::string lname(libutf8::to_u8string(lower));
-std::cerr << " --- ref: search for link named [" << lname << "]\n";
+}
 
-    auto it(f_links.find(lname));
-    if(it == f_links.end())
+
+/** \brief Generate the HTML of one segment.
+ *
+ * This function generates the HTML of the top-level block of segment
+ * \p s and saves the names of the references which were not found.
+ *
+ * \param[in,out] s  The segment to generate.
+ *
+ * \return The last block used by the segment (the last item of a list).
+ */
+block::pointer_t commonmark::generate_segment(segment_t & s)
+{
+    f_output.clear();
+    f_unresolved_references.clear();
+
+    block::pointer_t b(s.f_block);
+    generate_block(b);
+
+    s.f_html.swap(f_output);
+    s.f_unresolved_references.swap(f_unresolved_references);
+    f_output.clear();
+
+    return b;
+}
+
+
+/** \brief Return the HTML of the segments which are final.
+ *
+ * The segments are returned in order up to the first placeholder.
+ * When \p all is true, all the segments are returned.
+ *
+ * \param[in] all  Whether to return all the segments.
+ *
+ * \return The HTML of the released segments.
+ */
+std::string commonmark::release_segments(bool all)
+{
+    std::string result;
+    auto it(f_segments.begin());
+    for(; it != f_segments.end(); ++it)
     {
-        return link::pointer_t();
+        if(!all
+        && !it->f_unresolved_references.empty())
+        {
+            break;
+        }
+        result += it->f_html;
     }
-    return it->second;
+    f_segments.erase(f_segments.begin(), it);
+
+    return result;
+}
+
+
+/** \brief Request a hash of each top-level block.
+ *
+ * When this flag is set to true, the process() and process_blocks()
+ * functions compute a hash of the HTML generated for each top-level
+ * block. Along the hash, the position and size of that HTML in the
+ * output is saved.
+ *
+ * A client can keep the hashes of the last version of a document and
+ * compare them with the hashes of the new version. Only the blocks with
+ * a new hash need to be replaced in the DOM.
+ *
+ * The hash is stable: the same HTML always gives the same hash, whatever
+ * the platform.
+ *
+ * By default, no hashes are computed.
+ *
+ * \param[in] compute  Whether to compute the block hashes.
+ *
+ * \sa get_block_hashes()
+ */
+void commonmark::set_compute_block_hashes(bool compute)
+{
+    f_compute_block_hashes = compute;
+}
+
+
+/** \brief Retrieve the hashes of the top-level blocks.
+ *
+ * This function returns the hashes computed by the last call to
+ * process() or process_blocks(). The vector is empty if
+ * set_compute_block_hashes() was not called with true first.
+ *
+ * A list generates a single `<ul>` or `<ol>` tag and thus is
+ * represented by a single hash.
+ *
+ * \return A reference to the vector of block hashes.
+ */
+commonmark::block_hash_t::vector_t const & commonmark::get_block_hashes() const
+{
+    return f_block_hashes;
+}
+
+
+/** \brief Request a hash of the whole output.
+ *
+ * When this flag is set to true, the HTML gets hashed as it is
+ * generated, one top-level block at a time while the data is still in
+ * the cache, instead of having to go over the whole output once more
+ * after process() returns. The hash can be used as an HTTP ETag.
+ *
+ * This works with process(), process_blocks() and in stream mode, in
+ * which case the hash covers all the HTML returned by add_input() and
+ * finish().
+ *
+ * The same streaming_hash is used for the blocks so the hash is stable
+ * between runs and platforms.
+ *
+ * By default, the output hash is not computed.
+ *
+ * \param[in] compute  Whether to compute the output hash.
+ *
+ * \sa get_output_hash()
+ */
+void commonmark::set_compute_output_hash(bool compute)
+{
+    f_compute_output_hash = compute;
+}
+
+
+/** \brief Retrieve the hash of the output.
+ *
+ * This function returns the hash of the HTML generated by the last call
+ * to process() or process_blocks(), or by the current stream. If
+ * set_compute_output_hash() was not called with true first, the hash
+ * is the hash of an empty string.
+ *
+ * \return The 64 bit hash of the output.
+ */
+std::uint64_t commonmark::get_output_hash() const
+{
+    return f_output_hash.digest();
+}
+
+
+/** \brief Compute a key to cache the HTML of \p input.
+ *
+ * This function computes a hash of the \p input and of the settings
+ * which change the output. Two inputs with the same key give the same
+ * HTML, so the key can be used to search a render cache before calling
+ * process().
+ *
+ * The input is normalized the same way the parser does it: the
+ * "\r\n" and "\r" line endings are viewed as "\n" and the NUL
+ * characters as U+FFFD. The normalized input is not saved in memory,
+ * it gets hashed on the fly.
+ *
+ * The fingerprint() of this object is part of the key so changing the
+ * features or adding an extension gives a different key. The link
+ * reference definitions of the documents processed earlier are not
+ * part of the key since process() removes them first.
+ *
+ * \param[in] input  The markdown to be processed.
+ *
+ * \return The cache key of \p input.
+ */
+std::uint64_t commonmark::get_cache_key(std::string const & input) const
+{
+    streaming_hash h(fingerprint());
+
+    char const * s(input.data());
+    char const * const end(s + input.length());
+    char const * start(s);
+    for(; s < end; ++s)
+    {
+        if(*s == '\r')
+        {
+            h.add(start, s - start);
+            h.add("\n", 1);
+            if(s + 1 < end
+            && s[1] == '\n')
+            {
+                ++s;
+            }
+            start = s + 1;
+        }
+        else if(*s == '\0')
+        {
+            h.add(start, s - start);
+            h.add("\xEF\xBF\xBD", 3);
+            start = s + 1;
+        }
+    }
+    h.add(start, end - start);
+
+    return h.digest();
 }
 
 
-/** \brief Process the specified input data.
+/** \brief Compute a fingerprint of this commonmark object.
  *
- * This function processes the specified \p input data and returns the
- * resulting HTML.
+ * The fingerprint represents everything, except the input, which has
+ * an effect on the output:
  *
- * \param[in] input  The input markdown to convert to HTML.
+ * \li the features and the library version (see features::fingerprint());
+ * \li the inline and block extensions, in the order they were added
+ * (see inline_extension::identity() and block_extension::identity());
+ * \li the languages with a code renderer;
+ * \li whether a link rewriter is installed;
+ * \li the allowlist of the sanitizer, if any;
+ * \li the links added with add_link().
  *
- * \return The resulting HTML in a UTF-8 string.
+ * The code renderers and link rewriter are functions so only their
+ * presence can be taken in account. If their output can change, the
+ * caller has to add its own version to its cache keys.
+ *
+ * \return A 64 bit hash representing the settings of this object.
  */
-std::string commonmark::process(std::string const & input)
+std::uint64_t commonmark::fingerprint() const
 {
-    f_input = input;
-    f_output.clear();
+    streaming_hash h(f_features.fingerprint());
 
-    parse();
-std::cerr << "- * -------------------------------------------- TREE:\n";
-std::cerr << f_document->tree();
-std::cerr << "- * -------------------------------------------- TREE END ---\n";
-    generate(f_document);
+    for(auto const & e : f_inline_extensions)
+    {
+        std::string const identity("i:" + e->identity());
+        h.add(identity.c_str(), identity.length() + 1);
+    }
+    for(auto const & e : f_block_extensions)
+    {
+        std::string const identity("b:" + e->identity());
+        h.add(identity.c_str(), identity.length() + 1);
+    }
+    for(auto const & r : f_code_renderers)
+    {
+        std::string const language("c:" + r.first);
+        h.add(language.c_str(), language.length() + 1);
+    }
+    if(f_link_rewriter != nullptr)
+    {
+        h.add("l:", 3);
+    }
+    if(f_sanitizer != nullptr)
+    {
+        std::string const s("s:" + streaming_hash::to_string(f_sanitizer->fingerprint()));
+        h.add(s.c_str(), s.length() + 1);
+    }
+    for(auto const & l : f_user_links)
+    {
+        std::string const name("a:" + l.second->name());
+        h.add(name.c_str(), name.length() + 1);
+        std::size_t const max(l.second->uri_count());
+        for(std::size_t idx(0); idx < max; ++idx)
+        {
+            uri const & u(l.second->uri_details(idx));
+            h.add(u.is_reference() ? "r:" : "u:", 3);
+            h.add(u.destination().c_str(), u.destination().length() + 1);
+            h.add(u.title().c_str(), u.title().length() + 1);
+        }
+    }
 
-    return f_output;
+    return h.digest();
 }
 
 
@@ -1115,7 +2895,9 @@ std::cerr << "- * -------------------------------------------- TREE END ---\n";
  * The function transforms the NULL character in the \em replacement
  * \em character (a.k.a. 0xFFFD). The NULL character is viewed as a
  * potential security issue and it can be an annoyance in C/C++ strings
- * so it's a good thing all around for us.
+ * so it's a good thing all around for us. Invalid UTF-8 sequences were
+ * already replaced by that same character when parse() validated the
+ * input (see utf8_input).
  *
  * \return The character we just read.
  */
@@ -1131,14 +2913,12 @@ character commonmark::getc()
 #pragma GCC diagnostic ignored "-Wpedantic"
     character c =
     {
-        .f_char = *f_iterator,
+        .f_char = f_utf8_input.get(),
         .f_line = f_line,
         .f_column = f_column,
     };
 #pragma GCC diagnostic pop
 
-    ++f_iterator;
-
     // [REF] 2.2 Tabs
     //
     if(c.is_tab())
@@ -1162,9 +2942,9 @@ character commonmark::getc()
     //
     if(c.is_carriage_return())
     {
-        if(*f_iterator == CHAR_LINE_FEED)
+        if(f_utf8_input.peek_byte() == CHAR_LINE_FEED)
         {
-            ++f_iterator;
+            f_utf8_input.skip_byte();
         }
 
         // always replace the '\r' with '\n' so the rest of the parser
@@ -1226,7 +3006,7 @@ void commonmark::get_line()
 commonmark::input_status_t commonmark::get_current_status()
 {
     return input_status_t{
-            f_iterator,
+            f_utf8_input.position(),
             f_line,
             f_column,
             f_last_line,
@@ -1236,7 +3016,7 @@ commonmark::input_status_t commonmark::get_current_status()
 
 void commonmark::restore_status(input_status_t const & status)
 {
-    f_iterator = status.f_iterator;
+    f_utf8_input.set_position(status.f_position);
     f_line = status.f_line;
     f_column = status.f_column;
     f_last_line = status.f_last_line;
@@ -1304,9 +3084,10 @@ void commonmark::restore_status(input_status_t const & status)
  */
 void commonmark::parse()
 {
-    // reset iterator in case the parser is used multiple times
+    // validate the input and restart from the beginning in case the
+    // parser is used multiple times
     //
-    f_iterator.rewind();
+    f_utf8_input.reset(f_input);
     f_eos = false;
 
     // create a new document
@@ -1447,6 +3228,24 @@ std::cerr << " ---- early paragraph with blockquote empty line; got paragraph? "
             continue;
         }
 
+        if(it == f_last_line.cend()
+        || it->f_char >= 0x80
+        || !f_block_starters[it->f_char])
+        {
+            // no block starts with this character, it has to be
+            // a paragraph
+            //
+            process_paragraph(it);
+            append_line();
+            continue;
+        }
+
+        if(process_block_extensions(it))
+        {
+            append_line();
+            continue;
+        }
+
         if(process_fenced_code_block(it))
         {
 std::cerr << " ---- got fenced code block\n";
@@ -2796,7 +4595,12 @@ std::cerr << " ---- not reference (1)...\n";
         return false;
     }
 
+    // restoring the status may reallocate the line, so we have to
+    // recompute `it` on failures
+    //
     input_status_t const saved_status(get_current_status());
+    std::string::size_type const it_offset(it - f_last_line.cbegin());
+    std::uint32_t const line(it->f_line);
 
     auto et(it);
 
@@ -2810,15 +4614,18 @@ std::cerr << " ---- parse link text...\n";
     {
 std::cerr << " ---- not reference (2)...\n";
         restore_status(saved_status);
+        it = f_last_line.cbegin() + it_offset;
         return false;
     }
 
 std::cerr << " ---- check for colon: " << static_cast<int>(et->f_char) << "...\n";
     if(et == f_last_line.cend()
-    || !et->is_colon())
+    || !et->is_colon()
+    || !is_link_label(reference_name))
     {
 std::cerr << " ---- not reference (3)...\n";
         restore_status(saved_status);
+        it = f_last_line.cbegin() + it_offset;
         return false;
     }
 
@@ -2837,6 +4644,7 @@ std::cerr << " ---- skip blanks on next line...\n";
         {
 std::cerr << " ---- not reference (4)...\n";
             restore_status(saved_status);
+            it = f_last_line.cbegin() + it_offset;
             return false;
         }
     }
@@ -2851,6 +4659,7 @@ std::cerr << " ---- parse link destination...\n";
     {
 std::cerr << " ---- not reference (5)...\n";
         restore_status(saved_status);
+        it = f_last_line.cbegin() + it_offset;
         return false;
     }
 
@@ -2861,11 +4670,27 @@ std::cerr << " ---- add result as link reference ["
 << "] ["
 << link_title
 << "]...\n";
-    add_link(
-          reference_name
-        , link_destination
-        , link_title
-        , true);
+    if(f_streaming)
+    {
+        // the definition may still be incomplete (i.e. the title may
+        // appear in the next chunk) so it gets added once we know
+        //
+        definition_t d;
+        d.f_line = line;
+        d.f_name = reference_name;
+        d.f_destination = link_destination;
+        d.f_title = link_title;
+        f_definitions.push_back(d);
+    }
+    else
+    {
+        insert_link(
+              f_links
+            , reference_name
+            , link_destination
+            , link_title
+            , true);
+    }
 
     it = et;
     return true;
@@ -4332,6 +6157,139 @@ std::cerr << "- * -------------------------------- HTML BLOCK APPEND LOOP:\n"
 }
 
 
+/** \brief Let the block extensions convert the current line.
+ *
+ * This function calls the block extensions registered with the
+ * character found at \p it. The first extension which accepts the
+ * line generates the HTML of the whole block which gets saved in an
+ * extension block. Like HTML blocks, these are output verbatim, but
+ * they are not sanitized since they come from trusted code.
+ *
+ * If an extension read more lines and then rejects the input, the
+ * input gets restored before trying the next extension.
+ *
+ * \param[in,out] it  The position of the first character of the block.
+ *
+ * \return true if an extension converted the block.
+ */
+bool commonmark::process_block_extensions(character::string_t::const_iterator & it)
+{
+    // the lines read with get_line() would still include the marks and
+    // indentation of the containers and the block would not end with
+    // its container, so the extensions only work at the top level
+    //
+    if(it->f_char >= 0x80
+    || f_working_block != f_top_working_block)
+    {
+        return false;
+    }
+    block_extension::vector_t const & extensions(f_block_triggers[it->f_char]);
+    if(extensions.empty())
+    {
+        return false;
+    }
+
+    // restoring the status may reallocate the line, so we have to
+    // recompute `it` on failures
+    //
+    input_status_t const saved_status(get_current_status());
+    std::string::size_type const it_offset(it - f_last_line.cbegin());
+    character extension_block(*it);
+    extension_block.f_char = BLOCK_TYPE_EXTENSION;
+
+    for(auto const & e : extensions)
+    {
+        std::string html;
+        if(e->convert(
+                  f_last_line
+                , it
+                , [this]()
+                  {
+                      get_line();
+                      return !f_eos || !f_last_line.empty();
+                  }
+                , html))
+        {
+            block::pointer_t b(std::make_shared<block>(extension_block));
+            b->append(character::to_character_string(html));
+
+            f_working_block->link_child(b);
+            f_working_block = b;
+
+            it = f_last_line.cend();
+
+            return true;
+        }
+
+        restore_status(saved_status);
+        it = f_last_line.cbegin() + it_offset;
+    }
+
+    return false;
+}
+
+
+/** \brief Save the position of each top-level block.
+ *
+ * This function goes through the top-level blocks of the document and
+ * saves their starting line and byte offset in the block index. It also
+ * saves the link references since any block may make use of them.
+ *
+ * A list is composed of a set of top-level list items. These are viewed
+ * as one block since they generate one `<ul>` or `<ol>` tag.
+ */
+void commonmark::index_blocks()
+{
+    f_block_index.clear();
+
+    if(f_input.length() > std::numeric_limits<std::uint32_t>::max())
+    {
+        throw commonmark_out_of_range("input too large to build a block index.");
+    }
+    f_block_index.input_size(static_cast<std::uint32_t>(f_input.length()));
+
+    std::uint32_t line(1);
+    std::string::size_type offset(0);
+    for(block::pointer_t b(f_document->first_child());
+        b != nullptr;
+        b = b->next())
+    {
+        if(continues_list(b))
+        {
+            // this item is part of the previous list
+            //
+            continue;
+        }
+
+        std::uint32_t const start_line(block_start_line(b));
+        skip_lines(f_input, offset, line, start_line);
+
+        block_index::entry_t e;
+        e.f_offset = static_cast<std::uint32_t>(offset);
+        e.f_line = start_line;
+        e.f_type = b->type().f_char;
+        f_block_index.add_entry(e);
+    }
+
+    for(auto const & l : f_links)
+    {
+        std::size_t const max(l.second->uri_count());
+        for(std::size_t idx(0); idx < max; ++idx)
+        {
+            uri const & u(l.second->uri_details(idx));
+            if(u.is_reference())
+            {
+                block_index::reference_t r;
+                r.f_name = l.second->name();
+                r.f_destination = u.destination();
+                r.f_title = u.title();
+                f_block_index.add_reference(r);
+            }
+        }
+    }
+}
+
+
 /** \brief Transform all the blocks in HTML.
  *
  * Go through all the blocks one by one and generate the corresponding
@@ -4341,13 +6299,287 @@ std::cerr << "- * -------------------------------- HTML BLOCK APPEND LOOP:\n"
  */
 void commonmark::generate(block::pointer_t b)
 {
-    for(;
-        b != nullptr;
-        b = b->next())
+    generate_blocks(b, true);
+}
+
+
+/** \brief Transform one top-level block in HTML.
+ *
+ * This function generates the HTML of a direct child of the document.
+ * If requested, it also computes the hash of that HTML while it is
+ * still hot in the cache and saves it along its position in the output.
+ *
+ * \param[in,out] b  The top-level block to transform to HTML.
+ *
+ * \sa set_compute_block_hashes()
+ */
+void commonmark::generate_top_level_block(block::pointer_t & b)
+{
+    std::string::size_type const start(f_output.length());
+
+    generate_block(b);
+
+    if(f_compute_block_hashes)
     {
-        switch(b->type().f_char)
+        add_block_hash(start);
+    }
+}
+
+
+/** \brief Save the hash of the last top-level block.
+ *
+ * The HTML of the block starts at \p start and ends at the end of the
+ * current output.
+ *
+ * \param[in] start  The offset of the block HTML in the output.
+ */
+void commonmark::add_block_hash(std::string::size_type start)
+{
+    block_hash_t h;
+    h.f_offset = f_flushed_size + start;
+    h.f_size = f_output.length() - start;
+    h.f_hash = streaming_hash::hash(f_output.data() + start, h.f_size);
+    f_block_hashes.push_back(h);
+}
+
+
+/** \brief Send the output generated so far to the sink.
+ *
+ * This function is called each time a top-level block was generated.
+ * If requested, it adds the new output to the output hash. Then, when
+ * process() was called with an output sink, it writes the current output
+ * to that sink and clears it.
+ */
+void commonmark::flush_output()
+{
+    if(f_compute_output_hash)
+    {
+        f_output_hash.add(f_output.data() + f_hashed_size, f_output.length() - f_hashed_size);
+        f_hashed_size = f_output.length();
+    }
+
+    if(f_sink == nullptr
+    || f_output.empty())
+    {
+        return;
+    }
+
+    f_sink->write(f_output);
+    f_flushed_size += f_output.length();
+    f_output.clear();
+    f_hashed_size = 0;
+}
+
+
+/** \brief Call the slow document hook.
+ *
+ * This function gathers the details about the document which was just
+ * processed, saves it in the quarantine directory if requested, and
+ * calls the hook.
+ *
+ * \param[in] input  The input of the slow document.
+ * \param[in] parse_duration  The time spent parsing.
+ * \param[in] generate_duration  The time spent generating the HTML.
+ * \param[in] total_duration  The time spent in process().
+ */
+void commonmark::report_slow_document(
+          std::string const & input
+        , std::chrono::steady_clock::duration parse_duration
+        , std::chrono::steady_clock::duration generate_duration
+        , std::chrono::steady_clock::duration total_duration)
+{
+    slow_document_t details;
+    details.f_input_size = input.length();
+    details.f_input_hash = streaming_hash::hash(input.data(), input.length());
+    details.f_parse_duration = parse_duration;
+    details.f_generate_duration = generate_duration;
+    details.f_total_duration = total_duration;
+
+    // walk the tree without recursion
+    //
+    // (there is no tree when the plain text path was used)
+    //
+    std::size_t depth(1);
+    block::pointer_t b(f_document == nullptr ? block::pointer_t() : f_document->first_child());
+    while(b != nullptr)
+    {
+        ++details.f_block_count;
+        details.f_max_depth = std::max(details.f_max_depth, depth);
+
+        if(b->first_child() != nullptr)
+        {
+            b = b->first_child();
+            ++depth;
+            continue;
+        }
+        while(b != nullptr
+           && b->next() == nullptr)
+        {
+            b = b->parent();
+            --depth;
+            if(b == f_document)
+            {
+                b.reset();
+            }
+        }
+        if(b != nullptr)
+        {
+            b = b->next();
+        }
+    }
+
+    if(!f_quarantine_directory.empty())
+    {
+        if(mkdir(f_quarantine_directory.c_str(), 0700) == 0
+        || errno == EEXIST)
+        {
+            std::string const filename(
+                      f_quarantine_directory
+                    + '/'
+                    + streaming_hash::to_string(details.f_input_hash)
+                    + ".md");
+            std::ofstream out(filename, std::ios::binary);
+            out.write(input.data(), input.length());
+            out.close();
+            if(out)
+            {
+                details.f_quarantine_filename = filename;
+            }
+        }
+    }
+
+    f_slow_document_hook(details);
+}
+
+
+/** \brief Transform one block in HTML.
+ *
+ * This function generates the HTML of block \p b and its children.
+ *
+ * A list is composed of multiple sibling blocks. In that case, the
+ * function generates the whole list and \p b is set to the last item
+ * of that list on return.
+ *
+ * \param[in,out] b  The block to transform to HTML.
+ */
+void commonmark::generate_block(block::pointer_t & b)
+{
+    block::pointer_t const first(b);
+    if(is_list_item(b->type().f_char))
+    {
+        b = last_list_item(b);
+    }
+
+    generate_blocks(first, false);
+}
+
+
+/** \brief Transform blocks in HTML.
+ *
+ * This function generates the HTML of \p b and all of its descendants.
+ * If \p siblings is true, the siblings following \p b are also
+ * generated.
+ *
+ * The tree is walked using an explicit stack instead of recursion so
+ * very deep documents can't overflow the stack of the calling thread.
+ * Each frame on the stack represents a set of sibling blocks (or list
+ * items) being generated and the HTML to output once they are done.
+ * The stack vector is kept between calls so it does not have to be
+ * reallocated each time.
+ *
+ * \param[in] b  The first block to transform to HTML.
+ * \param[in] siblings  Whether to also transform the following siblings.
+ */
+void commonmark::generate_blocks(block::pointer_t b, bool siblings)
+{
+    std::size_t const bottom(f_generate_stack.size());
+
+    generate_frame_t frame;
+    frame.f_next = b;
+    frame.f_siblings = siblings;
+    f_generate_stack.push_back(frame);
+
+    while(f_generate_stack.size() > bottom)
+    {
+        // WARNING: `f` becomes invalid once a new frame gets pushed
+        //
+        generate_frame_t & f(f_generate_stack.back());
+
+        if(f.f_start != std::string::npos)
+        {
+            if(f_compute_block_hashes)
+            {
+                add_block_hash(f.f_start);
+            }
+            f.f_start = std::string::npos;
+            flush_output();
+        }
+
+        if(f.f_next == nullptr)
+        {
+            f_output += f.f_close;
+            f_generate_stack.pop_back();
+            continue;
+        }
+
+        block::pointer_t current(f.f_next);
+
+        if(f.f_list_type != U'\0')
+        {
+            f.f_next = current->next();
+            if(f.f_next != nullptr
+            && f.f_next->type().f_char != f.f_list_type)
+            {
+                f.f_next.reset();
+            }
+            generate_list_item(current, f.f_tight_list);
+            continue;
+        }
+
+        if(!f.f_siblings)
+        {
+            f.f_next.reset();
+        }
+        else if(is_list_item(current->type().f_char))
+        {
+            // the list takes all the items at once
+            //
+            f.f_next = last_list_item(current)->next();
+        }
+        else
+        {
+            f.f_next = current->next();
+        }
+
+        if(f.f_top_level)
+        {
+            f.f_start = f_output.length();
+        }
+
+        generate_block_start(current);
+    }
+}
+
+
+/** \brief Start the transformation of one block in HTML.
+ *
+ * This function generates the HTML of block \p b. If the block has
+ * children, a frame is pushed on the generation stack so they get
+ * generated next, followed by the closing tags of \p b.
+ *
+ * \param[in] b  The block to transform to HTML.
+ */
+void commonmark::generate_block_start(block::pointer_t b)
+{
+    switch(b->type().f_char)
+    {
+    case BLOCK_TYPE_DOCUMENT:
         {
-        case BLOCK_TYPE_DOCUMENT:
+            generate_frame_t frame;
+            frame.f_next = b->first_child();
+            frame.f_top_level = f_compute_block_hashes
+                             || f_compute_output_hash
+                             || f_sink != nullptr;
             if(f_features.get_add_document_div())
             {
                 if(f_features.get_add_classes())
@@ -4358,113 +6590,128 @@ void commonmark::generate(block::pointer_t b)
                 {
                     f_output += "<div>";
                 }
-                generate(b->first_child());
-                f_output += "</div>";
-            }
-            else
-            {
-                generate(b->first_child());
+                frame.f_close = "</div>";
             }
-            break;
+            f_generate_stack.push_back(frame);
+        }
+        break;
 
-        case BLOCK_TYPE_PARAGRAPH:
-            f_output += "<p>";
-            generate_inline(b->content());
-            f_output += "</p>\n";
-            break;
+    case BLOCK_TYPE_PARAGRAPH:
+        f_output += "<p>";
+        generate_inline(b->content());
+        f_output += "</p>\n";
+        break;
 
-        case BLOCK_TYPE_TEXT:
-            generate_inline(b->content());
-            break;
+    case BLOCK_TYPE_TEXT:
+        generate_inline(b->content());
+        break;
 
-        case BLOCK_TYPE_CODE_BLOCK_INDENTED:
-        case BLOCK_TYPE_CODE_BLOCK_GRAVE:
-        case BLOCK_TYPE_CODE_BLOCK_TILDE:
-            f_output += "<pre>";
-            generate_code(b);
-            f_output += "</pre>\n";
-            break;
+    case BLOCK_TYPE_CODE_BLOCK_INDENTED:
+    case BLOCK_TYPE_CODE_BLOCK_GRAVE:
+    case BLOCK_TYPE_CODE_BLOCK_TILDE:
+        f_output += "<pre>";
+        generate_code(b);
+        f_output += "</pre>\n";
+        break;
 
-        case BLOCK_TYPE_BLOCKQUOTE:
-            // instead of adding blocks of type blockquote, we increase the
-            // level; but here we have to generate L <blockquote> tags
-            //
+    case BLOCK_TYPE_BLOCKQUOTE:
+        // instead of adding blocks of type blockquote, we increase the
+        // level; but here we have to generate L <blockquote> tags
+        //
+        {
+            generate_frame_t frame;
             for(int count(0); count < b->number(); ++count)
             {
                 f_output += "<blockquote>\n";
+                frame.f_close += "</blockquote>\n";
             }
+
+            bool do_generate(true);
+            if(b->children_size() == 1
+            && b->first_child()->is_paragraph())
             {
-                bool do_generate(true);
-                if(b->children_size() == 1
-                && b->first_child()->is_paragraph())
-                {
-                    character::string_t content(b->first_child()->content());
-                    auto it(content.cbegin());
-                    for(;
-                        it != content.cend()
-                            && (it->is_blank() || it->is_eol());
-                        ++it);
-                    do_generate = it != content.cend();
-                }
-                if(do_generate)
-                {
-                    generate(b->first_child());
-                }
+                character::string_t content(b->first_child()->content());
+                auto it(content.cbegin());
+                for(;
+                    it != content.cend()
+                        && (it->is_blank() || it->is_eol());
+                    ++it);
+                do_generate = it != content.cend();
             }
-            for(int count(0); count < b->number(); ++count)
+            if(do_generate)
             {
-                f_output += "</blockquote>\n";
+                frame.f_next = b->first_child();
             }
-            break;
+            f_generate_stack.push_back(frame);
+        }
+        break;
 
-        case BLOCK_TYPE_LIST_ASTERISK:
-        case BLOCK_TYPE_LIST_PLUS:
-        case BLOCK_TYPE_LIST_DASH:
-        case BLOCK_TYPE_LIST_PERIOD:
-        case BLOCK_TYPE_LIST_PARENTHESIS:
-            generate_list(b);
-            break;
+    case BLOCK_TYPE_LIST_ASTERISK:
+    case BLOCK_TYPE_LIST_PLUS:
+    case BLOCK_TYPE_LIST_DASH:
+    case BLOCK_TYPE_LIST_PERIOD:
+    case BLOCK_TYPE_LIST_PARENTHESIS:
+        generate_list(b);
+        break;
 
-        case BLOCK_TYPE_HEADER_OPEN:
-        case BLOCK_TYPE_HEADER_ENCLOSED:
-        case BLOCK_TYPE_HEADER_SINGLE:
-        case BLOCK_TYPE_HEADER_DOUBLE:
-            generate_header(b);
-            break;
+    case BLOCK_TYPE_HEADER_OPEN:
+    case BLOCK_TYPE_HEADER_ENCLOSED:
+    case BLOCK_TYPE_HEADER_SINGLE:
+    case BLOCK_TYPE_HEADER_DOUBLE:
+        generate_header(b);
+        break;
 
-        case BLOCK_TYPE_BREAK_DASH:
-        case BLOCK_TYPE_BREAK_ASTERISK:
-        case BLOCK_TYPE_BREAK_UNDERLINE:
-            generate_thematic_break(b);
-            break;
+    case BLOCK_TYPE_BREAK_DASH:
+    case BLOCK_TYPE_BREAK_ASTERISK:
+    case BLOCK_TYPE_BREAK_UNDERLINE:
+        generate_thematic_break(b);
+        break;
 
-        case BLOCK_TYPE_TAG:
-            // copy verbatim
-            //
-            f_output += character::to_utf8(b->content());
-            //f_output += '\n'; -- added when read
+    case BLOCK_TYPE_TAG:
+        if(f_sanitizer != nullptr)
+        {
+            f_output += sanitize_html(
+                              b->content()
+                            , *f_sanitizer
+                            , f_features.get_add_space_in_empty_tag());
             break;
+        }
+        // copy verbatim
+        //
+        f_output += character::to_utf8(b->content());
+        //f_output += '\n'; -- added when read
+        break;
 
-        default:
-            throw commonmark_logic_error(
-                      "unrecognized block type ("
-                    + std::to_string(static_cast<int>(b->type().f_char))
-                    + ") while generate HTML data"
-                );
+    case BLOCK_TYPE_EXTENSION:
+        f_output += character::to_utf8(b->content());
+        break;
+
+    default:
+        throw commonmark_logic_error(
+                  "unrecognized block type ("
+                + std::to_string(static_cast<int>(b->type().f_char))
+                + ") while generate HTML data"
+            );
 
-        }
     }
 }
 
 
-void commonmark::generate_list(block::pointer_t & b)
+/** \brief Start the transformation of a list in HTML.
+ *
+ * This function generates the opening tag of the list starting with
+ * item \p b and pushes a frame on the generation stack to generate
+ * all the items of that list.
+ *
+ * \param[in] b  The first item of the list.
+ */
+void commonmark::generate_list(block::pointer_t b)
 {
     // open the tag
     //
-    std::string tag;
+    generate_frame_t frame;
     if(b->is_ordered_list())
     {
-        tag = "ol";
         f_output += "<ol";
         if(b->number() != 1)
         {
@@ -4472,11 +6719,12 @@ void commonmark::generate_list(block::pointer_t & b)
             f_output += std::to_string(b->number());
             f_output += '"';
         }
+        frame.f_close = "</ol>\n";
     }
     else
     {
-        tag = "ul";
         f_output += "<ul";
+        frame.f_close = "</ul>\n";
     }
 
     char32_t const type_of_list(b->type().f_char);
@@ -4510,200 +6758,518 @@ void commonmark::generate_list(block::pointer_t & b)
 
     f_output += ">\n";
 
-    bool const tight_list(b->is_tight_list());
+    frame.f_next = b;
+    frame.f_list_type = type_of_list;
+    frame.f_tight_list = b->is_tight_list();
 
 //std::cerr << "- * ---------------------------- DOCUMENT TREE BEFORE CHECKING LIST TIGHT:\n";
 //std::cerr << b->tree();
 //std::cerr << "- * ---------------------------- DOCUMENT TREE BEFORE CHECKING LIST TIGHT END\n";
-//std::cerr << "  >>> LIST IS CONSIDERED TIGHT? " << std::boolalpha << tight_list << "\n";
+//std::cerr << "  >>> LIST IS CONSIDERED TIGHT? " << std::boolalpha << frame.f_tight_list << "\n";
+
+    f_generate_stack.push_back(frame);
+}
 
-    // create all the items
+
+/** \brief Start the transformation of a list item in HTML.
+ *
+ * This function generates the opening tag of list item \p b and
+ * pushes a frame on the generation stack to generate its children.
+ *
+ * \param[in] b  The list item to transform to HTML.
+ * \param[in] tight_list  Whether the list is tight.
+ */
+void commonmark::generate_list_item(block::pointer_t b, bool tight_list)
+{
+    // if the list item is not sparse, make sure to generate the
+    // output as inline data instead of a paragraph
     //
-    block::pointer_t next;
-    for(;;)
+    // [REF] 5.3 Lists (see loose vs tight for the tests below)
+    //
+    f_output += "<li>";
+
+    generate_frame_t frame;
+    frame.f_close = "</li>";
+    frame.f_close += f_features.get_line_feed();
+
+    //if((!b->followed_by_an_empty_line() || && b->children_size() == 1)
+    //&& b->first_child() != nullptr
+    //&& b->first_child()->is_paragraph())
+    if(b->first_child()->is_paragraph()
+    && (tight_list
+        || (b->children_size() == 1
+            && b->first_child()->content().empty())))
     {
-        // if the list item is not sparse, make sure to generate the
-        // output as inline data instead of a paragraph
-        //
-        // [REF] 5.3 Lists (see loose vs tight for the tests below)
+        generate_inline(b->first_child()->content());
+
+        // there can be more sub-items
         //
-        f_output += "<li>";
+        if(b->first_child()->next() != nullptr)
+        {
+            f_output += f_features.get_line_feed();
+            frame.f_next = b->first_child()->next();
+        }
+    }
+    else
+    {
+        f_output += f_features.get_line_feed();
+        frame.f_next = b->first_child();
+    }
+
+    f_generate_stack.push_back(frame);
+}
+
 
-        //if((!b->followed_by_an_empty_line() || && b->children_size() == 1)
-        //&& b->first_child() != nullptr
-        //&& b->first_child()->is_paragraph())
-        if(b->first_child()->is_paragraph()
-        && (tight_list
-            || (b->children_size() == 1
-                && b->first_child()->content().empty())))
+void commonmark::generate_header(block::pointer_t b)
+{
+    f_output += "<h";
+    f_output += std::to_string(b->number());
+    if(f_features.get_add_classes())
+    {
+        switch(b->type().f_char)
         {
-            generate_inline(b->first_child()->content());
+        case BLOCK_TYPE_HEADER_OPEN:
+            f_output += " class=\"cm-header-open\"";
+            break;
 
-            // there can be more sub-items
-            //
-            if(b->first_child()->next() != nullptr)
+        case BLOCK_TYPE_HEADER_ENCLOSED:
+            f_output += " class=\"cm-header-enclosed\"";
+            break;
+
+        case BLOCK_TYPE_HEADER_SINGLE:
+            f_output += " class=\"cm-header-underline cm-header-dash\"";
+            break;
+
+        case BLOCK_TYPE_HEADER_DOUBLE:
+            f_output += " class=\"cm-header-underline cm-header-equal\"";
+            break;
+
+        }
+
+        // also add an identifier if not empty
+        //
+        std::string const id(to_identifier(b->content()));
+        if(!id.empty())
+        {
+            f_output += " id=\"" + id + "\"";
+        }
+    }
+    f_output += ">";
+
+    // note: an empty title is considered valid by commonmark
+    //
+    generate_inline(b->content());
+
+    f_output += "</h";
+    f_output += std::to_string(b->number());
+    f_output += ">";
+    f_output += f_features.get_line_feed();
+}
+
+
+std::string commonmark::to_identifier(character::string_t const & line)
+{
+    std::string id;
+
+    for(character::string_t::const_iterator it(line.begin());
+        it != line.end();
+        ++it)
+    {
+        if(it->f_char >= U'A' && it->f_char <= U'Z')
+        {
+            id += static_cast<char>(it->f_char | 0x20);
+        }
+        else if(it->f_char >= U'a' && it->f_char <= U'z')
+        {
+            id += static_cast<char>(it->f_char);
+        }
+        else if(it->f_char >= U'0' && it->f_char <= U'9')
+        {
+            if(id.empty())
             {
-                f_output += f_features.get_line_feed();
-                generate(b->first_child()->next());
+                id += "id-";
             }
+            id += static_cast<char>(it->f_char);
         }
-        else
+        else if(it->f_char == CHAR_TAB
+             || it->f_char == CHAR_SPACE
+             || it->f_char == CHAR_DASH)
         {
-            f_output += f_features.get_line_feed();
-            generate(b->first_child());
+            if(!id.empty())
+            {
+                id += '-';
+            }
+        }
+        else if(it->f_char == CHAR_UNDERSCORE)
+        {
+            id += '_';
+        }
+    }
+
+    while(!id.empty()
+       && id.back() == '-')
+    {
+        id.pop_back();
+    }
+
+    return id;
+}
+
+
+void commonmark::generate_thematic_break(block::pointer_t b)
+{
+    f_output += "<hr";
+
+    if(f_features.get_add_classes())
+    {
+        f_output += " class=\"";
+
+        switch(b->type().f_char)
+        {
+        case BLOCK_TYPE_BREAK_DASH:
+            f_output += "cm-break-dash";
+            break;
+
+        case BLOCK_TYPE_BREAK_UNDERLINE:
+            f_output += "cm-break-underline";
+            break;
+
+        case BLOCK_TYPE_BREAK_ASTERISK:
+            f_output += "cm-break-asterisk";
+            break;
+
+        }
+        f_output += '"';
+    }
+
+    if(f_features.get_add_space_in_empty_tag())
+    {
+        f_output += ' ';
+    }
+    f_output += "/>";
+    f_output += f_features.get_line_feed();
+}
+
+
+/** \brief Compute the block parser tables.
+ *
+ * The block starters table marks the characters which can start a leaf
+ * block: the default ones and the trigger characters of the block
+ * extensions. The triggers table lists the extensions to call for each
+ * of those characters.
+ */
+void commonmark::build_block_tables()
+{
+    f_block_starters = g_block_starters;
+    for(auto & t : f_block_triggers)
+    {
+        t.clear();
+    }
+    for(auto const & e : f_block_extensions)
+    {
+        for(auto const c : e->triggers())
+        {
+            f_block_starters[c] = true;
+            f_block_triggers[c].push_back(e);
+        }
+    }
+
+    build_plain_text_table();
+}
+
+
+/** \brief Compute the inline parser tables.
+ *
+ * The inline parser copies the characters which are not marked in the
+ * specials table as is. This function marks the characters with a
+ * special meaning according to the current features and the trigger
+ * characters of the inline extensions. The triggers table lists the
+ * extensions to call for each of those characters.
+ */
+void commonmark::build_inline_tables()
+{
+    f_inline_specials = f_features.get_ins_del_extension()
+                            ? g_inline_specials_ins_del
+                            : g_inline_specials;
+    for(auto & t : f_inline_triggers)
+    {
+        t.clear();
+    }
+    for(auto const & e : f_inline_extensions)
+    {
+        for(auto const c : e->triggers())
+        {
+            f_inline_specials[c] = true;
+            f_inline_triggers[c].push_back(e);
+        }
+    }
+
+    build_plain_text_table();
+}
+
+
+/** \brief Compute the table used to detect plain text.
+ *
+ * Each byte gets a set of flags telling is_plain_text() whether it can
+ * start some markup. The table is built from the block starters and the
+ * inline specials so the trigger characters of the extensions are taken
+ * in account.
+ *
+ * Bytes with no flags are always copied as is to the output.
+ */
+void commonmark::build_plain_text_table()
+{
+    f_plain_text_table.fill(0);
+
+    for(std::size_t c(0); c < 0x80; ++c)
+    {
+        if(c < 0x20
+        || c == 0x7F
+        || f_inline_specials[c])
+        {
+            f_plain_text_table[c] |= PLAIN_TEXT_SPECIAL;
+        }
+        if(f_block_starters[c])
+        {
+            f_plain_text_table[c] |= PLAIN_TEXT_LINE_START;
+        }
+    }
+    for(std::size_t c(0x80); c < f_plain_text_table.size(); ++c)
+    {
+        f_plain_text_table[c] = PLAIN_TEXT_CHECK;
+    }
+
+    // line endings, and a few inline specials which in plain text only
+    // get escaped, need to be checked unless an extension uses them
+    //
+    f_plain_text_table[CHAR_LINE_FEED] = PLAIN_TEXT_CHECK;
+    f_plain_text_table[CHAR_CARRIAGE_RETURN] = PLAIN_TEXT_CHECK;
+    for(auto const c : { CHAR_SPACE, CHAR_EXCLAMATION_MARK, CHAR_QUOTE, CHAR_CLOSE_ANGLE_BRACKET })
+    {
+        if(f_inline_triggers[c].empty())
+        {
+            f_plain_text_table[c] &= ~PLAIN_TEXT_SPECIAL;
+            f_plain_text_table[c] |= PLAIN_TEXT_CHECK;
+        }
+    }
+
+    // other characters which start a container or a block
+    //
+    f_plain_text_table[CHAR_SPACE] |= PLAIN_TEXT_LINE_START;           // indentation
+    f_plain_text_table[CHAR_CLOSE_ANGLE_BRACKET] |= PLAIN_TEXT_LINE_START; // blockquote
+    f_plain_text_table[CHAR_PLUS] |= PLAIN_TEXT_LINE_START;            // list
+    f_plain_text_table[CHAR_DASH] |= PLAIN_TEXT_LINE_START;            // list
+    for(char32_t c(CHAR_ZERO); c <= CHAR_NINE; ++c)
+    {
+        f_plain_text_table[c] |= PLAIN_TEXT_LINE_START;                 // ordered list
+    }
+}
+
+
+/** \brief Check whether the input includes any markup.
+ *
+ * This function goes through the \p input once and checks each byte
+ * against a table of the bytes which could start some markup. When it
+ * finds none, the document is only composed of paragraphs of plain
+ * text which generate_plain_text() can convert without the parser.
+ *
+ * This function is conservative: a byte which might start some markup
+ * makes it return false, even if the full parser would end up treating
+ * it as text (i.e. `2021 was great` is plain text, but `2021.` could
+ * start an ordered list so we do not accept a number at the start of
+ * a line followed by a period or a parenthesis).
+ *
+ * \param[in] input  The input to check.
+ *
+ * \return true if the input can be converted by generate_plain_text().
+ */
+bool commonmark::is_plain_text(std::string const & input) const
+{
+    unsigned char const * s(reinterpret_cast<unsigned char const *>(input.data()));
+    unsigned char const * const end(s + input.length());
+    bool start_of_line(true);
+    bool non_ascii(false);
+    for(; s < end; ++s)
+    {
+        std::uint8_t const flags(f_plain_text_table[*s]);
+        if(flags == 0)
+        {
+            start_of_line = false;
+            continue;
         }
-        f_output += "</li>";
-        f_output += f_features.get_line_feed();
 
-        if(b->next() == nullptr)
+        if(start_of_line
+        && (flags & PLAIN_TEXT_LINE_START) != 0)
         {
-            break;
+            if(*s < CHAR_ZERO
+            || *s > CHAR_NINE)
+            {
+                return false;
+            }
+            for(++s; s < end && *s >= CHAR_ZERO && *s <= CHAR_NINE; ++s);
+            if(s < end
+            && (*s == CHAR_PERIOD || *s == CHAR_CLOSE_PARENTHESIS))
+            {
+                return false;
+            }
+            --s;
+            start_of_line = false;
+            continue;
         }
 
-        if(b->next()->type().f_char != type_of_list)
+        if((flags & PLAIN_TEXT_SPECIAL) != 0)
         {
-            break;
+            return false;
         }
 
-        b = b->next();
-    }
-
-    // close the tag
-    //
-    f_output += "</";
-    f_output += tag;
-    f_output += ">\n";
-}
-
-
-void commonmark::generate_header(block::pointer_t b)
-{
-    f_output += "<h";
-    f_output += std::to_string(b->number());
-    if(f_features.get_add_classes())
-    {
-        switch(b->type().f_char)
+        switch(*s)
         {
-        case BLOCK_TYPE_HEADER_OPEN:
-            f_output += " class=\"cm-header-open\"";
-            break;
-
-        case BLOCK_TYPE_HEADER_ENCLOSED:
-            f_output += " class=\"cm-header-enclosed\"";
-            break;
+        case CHAR_LINE_FEED:
+        case CHAR_CARRIAGE_RETURN:
+            start_of_line = true;
+            continue;
 
-        case BLOCK_TYPE_HEADER_SINGLE:
-            f_output += " class=\"cm-header-underline cm-header-dash\"";
+        case CHAR_SPACE:
+            // two spaces may be a hard break and trailing spaces get
+            // removed
+            //
+            if(s + 1 == end
+            || s[1] == CHAR_SPACE
+            || s[1] == CHAR_LINE_FEED
+            || s[1] == CHAR_CARRIAGE_RETURN)
+            {
+                return false;
+            }
             break;
 
-        case BLOCK_TYPE_HEADER_DOUBLE:
-            f_output += " class=\"cm-header-underline cm-header-equal\"";
+        default:
+            if(*s >= 0x80)
+            {
+                non_ascii = true;
+            }
             break;
 
         }
-
-        // also add an identifier if not empty
-        //
-        std::string const id(to_identifier(b->content()));
-        if(!id.empty())
-        {
-            f_output += " id=\"" + id + "\"";
-        }
+        start_of_line = false;
     }
-    f_output += ">";
 
-    // note: an empty title is considered valid by commonmark
+    // the parser replaces invalid UTF-8 sequences
     //
-    generate_inline(b->content());
-
-    f_output += "</h";
-    f_output += std::to_string(b->number());
-    f_output += ">";
-    f_output += f_features.get_line_feed();
+    return !non_ascii
+        || utf8_input::valid_length(input) == input.length();
 }
 
 
-std::string commonmark::to_identifier(character::string_t const & line)
+/** \brief Convert an input without markup.
+ *
+ * This function generates the HTML of an input which is_plain_text()
+ * accepted. Each group of lines separated by empty lines becomes a
+ * paragraph and the double quotes and closing angle brackets get
+ * escaped. The
+ * output is exactly the same as the one the parser would generate,
+ * including the block hashes and the flushing of each paragraph.
+ *
+ * \param[in] input  The plain text to convert.
+ */
+void commonmark::generate_plain_text(std::string const & input)
 {
-    std::string id;
+    bool const top_level(f_compute_block_hashes
+                      || f_compute_output_hash
+                      || f_sink != nullptr);
 
-    for(character::string_t::const_iterator it(line.begin());
-        it != line.end();
-        ++it)
+    std::string close;
+    if(f_features.get_add_document_div())
     {
-        if(it->f_char >= U'A' && it->f_char <= U'Z')
+        if(f_features.get_add_classes())
         {
-            id += static_cast<char>(it->f_char | 0x20);
+            f_output += "<div class=\"cm-document\">";
         }
-        else if(it->f_char >= U'a' && it->f_char <= U'z')
+        else
         {
-            id += static_cast<char>(it->f_char);
+            f_output += "<div>";
         }
-        else if(it->f_char >= U'0' && it->f_char <= U'9')
+        close = "</div>";
+    }
+
+    std::string::size_type start(std::string::npos);
+    auto end_paragraph = [this, top_level, &start]()
+    {
+        f_output += "</p>\n";
+        if(top_level)
         {
-            if(id.empty())
+            if(f_compute_block_hashes)
             {
-                id += "id-";
+                add_block_hash(start);
             }
-            id += static_cast<char>(it->f_char);
+            flush_output();
         }
-        else if(it->f_char == CHAR_TAB
-             || it->f_char == CHAR_SPACE
-             || it->f_char == CHAR_DASH)
+        start = std::string::npos;
+    };
+
+    char const * s(input.data());
+    char const * const end(s + input.length());
+    while(s < end)
+    {
+        char const * eol(s);
+        for(; eol < end && *eol != '\n' && *eol != '\r'; ++eol);
+
+        if(eol == s)
         {
-            if(!id.empty())
+            if(start != std::string::npos)
             {
-                id += '-';
+                end_paragraph();
             }
         }
-        else if(it->f_char == CHAR_UNDERSCORE)
+        else
         {
-            id += '_';
-        }
-    }
-
-    while(!id.empty()
-       && id.back() == '-')
-    {
-        id.pop_back();
-    }
-
-    return id;
-}
-
-
-void commonmark::generate_thematic_break(block::pointer_t b)
-{
-    f_output += "<hr";
+            if(start == std::string::npos)
+            {
+                start = f_output.length();
+                f_output += "<p>";
+            }
+            else
+            {
+                f_output += '\n';
+            }
 
-    if(f_features.get_add_classes())
-    {
-        f_output += " class=\"";
+            char const * plain(s);
+            for(; s < eol; ++s)
+            {
+                if(*s == '"')
+                {
+                    f_output.append(plain, s - plain);
+                    f_output += "&quot;";
+                    plain = s + 1;
+                }
+                else if(*s == '>')
+                {
+                    f_output.append(plain, s - plain);
+                    f_output += "&gt;";
+                    plain = s + 1;
+                }
+            }
+            f_output.append(plain, eol - plain);
+        }
 
-        switch(b->type().f_char)
+        s = eol;
+        if(s < end)
         {
-        case BLOCK_TYPE_BREAK_DASH:
-            f_output += "cm-break-dash";
-            break;
-
-        case BLOCK_TYPE_BREAK_UNDERLINE:
-            f_output += "cm-break-underline";
-            break;
-
-        case BLOCK_TYPE_BREAK_ASTERISK:
-            f_output += "cm-break-asterisk";
-            break;
-
+            if(*s == '\r'
+            && s + 1 < end
+            && s[1] == '\n')
+            {
+                ++s;
+            }
+            ++s;
         }
-        f_output += '"';
     }
 
-    if(f_features.get_add_space_in_empty_tag())
+    if(start != std::string::npos)
     {
-        f_output += ' ';
+        end_paragraph();
     }
-    f_output += "/>";
-    f_output += f_features.get_line_feed();
+
+    f_output += close;
 }
 
 
@@ -4714,14 +7280,28 @@ std::cerr << " ---- inline to parse: [" << line << "]\n";
     class inline_parser
     {
     public:
+        struct backtick_run_t
+        {
+            std::vector<std::size_t>    f_positions = std::vector<std::size_t>();   // start of each run, sorted
+            std::size_t                 f_next = 0;                                 // cursor in f_positions
+        };
+
         inline_parser(
                   character::string_t const & line
                 , features const & f
-                , link::find_link_reference_t find_link_reference)
+                , link::find_link_reference_t find_link_reference
+                , inline_specials_t const & specials
+                , inline_triggers_t const & triggers
+                , link_rewriter_t const & link_rewriter
+                , sanitizer const * s)
             : f_line(line)
             , f_it(f_line.cbegin())
             , f_features(f)
             , f_find_link_reference(find_link_reference)
+            , f_specials(specials)
+            , f_triggers(triggers)
+            , f_link_rewriter(link_rewriter)
+            , f_sanitizer(s)
         {
         }
 
@@ -4741,6 +7321,33 @@ std::cerr << " ---- inline to parse: [" << line << "]\n";
         std::string convert_char()
         {
             std::string result;
+            convert_plain_text(result);
+            if(!result.empty())
+            {
+                // return so callers (i.e. convert_span()) can check for
+                // their closing mark before we handle the next character
+                //
+                return result;
+            }
+
+            if(f_it->f_char < 0x80)
+            {
+                for(auto const & e : f_triggers[f_it->f_char])
+                {
+                    auto et(f_it);
+                    if(e->convert(f_line, et, result))
+                    {
+                        if(et <= f_it)
+                        {
+                            throw commonmark_logic_error("an inline extension accepted the input without moving the iterator forward.");
+                        }
+                        f_it = et;
+                        return result;
+                    }
+                    result.clear();
+                }
+            }
+
             character previous{};
             if(f_it != f_line.cbegin())
             {
@@ -4885,7 +7492,6 @@ std::cerr << " ---- inline to parse: [" << line << "]\n";
                     // keep the '!' as is otherwise
                     //
                     result += '!';
-                    --f_it;
                 }
                 break;
 
@@ -4898,98 +7504,177 @@ std::cerr << " ---- inline to parse: [" << line << "]\n";
             return result;
         }
 
+        void convert_plain_text(std::string & result)
+        {
+            // copy characters without any special meaning in one go;
+            // a blank is plain only when followed by a character which
+            // is neither a blank nor an end of line (which could mean
+            // a hard break or the end of the content)
+            //
+            for(; f_it != f_line.cend(); ++f_it)
+            {
+                char32_t const c(f_it->f_char);
+                if(c >= 0x80)
+                {
+                    result += f_it->to_utf8();
+                    continue;
+                }
+                if(f_specials[c])
+                {
+                    if(!f_it->is_blank()
+                    || f_it + 1 == f_line.cend()
+                    || f_it[1].is_blank()
+                    || f_it[1].is_eol())
+                    {
+                        return;
+                    }
+                }
+                result += static_cast<char>(c);
+            }
+        }
+
         std::string convert_inline_code()
         {
             // [REF] 6.1 Code spans
             //
-            std::string mark("`"); // the start & end mark must match in length, length which is not limited
+            // the start & end mark must match in length, length which is
+            // not limited
+            //
+            auto const start(f_it);
             for(++f_it;
                 f_it != f_line.cend() && f_it->is_grave();
-                ++f_it)
-            {
-                mark += '`';
-            }
+                ++f_it);
+            std::size_t const length(f_it - start);
 
             // WARNING: the following is NOT a span if we find an end mark
             //          since the characters within represent code (i.e. which
             //          means *blah* is not an emphasis, etc.)
             //
-            for(auto code(f_it); code != f_line.cend(); ++code)
+            auto const code(find_backtick_run(length));
+            if(code == f_line.cend())
             {
-                auto et(code);
+                // no closing mark, the backticks are taken literally
+                //
+                return std::string(length, '`');
+            }
 
-                bool found_mark(true);
-                for(auto c : mark)
-                {
-                    if(et != f_line.cend()
-                    && et->f_char != static_cast<char32_t>(c))
-                    {
-                        found_mark = false;
-                        break;
-                    }
-                    ++et;
-                }
+            std::string result;
 
-                if(found_mark)
+            bool blank(true);
+            for(; f_it != code; ++f_it)
+            {
+                switch(f_it->f_char)
                 {
-                    std::string result;
+                case CHAR_SPACE:
+                case CHAR_LINE_FEED:
+                    result += ' ';
+                    break;
 
-                    bool blank(true);
-                    for(; f_it != code; ++f_it)
-                    {
-                        switch(f_it->f_char)
-                        {
-                        case CHAR_SPACE:
-                        case CHAR_LINE_FEED:
-                            result += ' ';
-                            break;
+                case CHAR_TAB:
+                    result += '\t';
+                    break;
 
-                        case CHAR_TAB:
-                            result += '\t';
-                            break;
+                case CHAR_AMPERSAND:
+                    blank = false;
+                    result += "&amp;";
+                    break;
 
-                        case CHAR_AMPERSAND:
-                            blank = false;
-                            result += "&amp;";
-                            break;
+                case CHAR_OPEN_ANGLE_BRACKET:
+                    blank = false;
+                    result += "&lt;";
+                    break;
 
-                        case CHAR_OPEN_ANGLE_BRACKET:
-                            blank = false;
-                            result += "&lt;";
-                            break;
+                case CHAR_CLOSE_ANGLE_BRACKET:
+                    blank = false;
+                    result += "&gt;";
+                    break;
 
-                        case CHAR_CLOSE_ANGLE_BRACKET:
-                            blank = false;
-                            result += "&gt;";
-                            break;
+                default:
+                    blank = false;
+                    result += f_it->to_utf8();
+                    break;
 
-                        default:
-                            blank = false;
-                            result += f_it->to_utf8();
-                            break;
+                }
+            }
 
-                        }
-                    }
+            // then jump after the mark
+            //
+            f_it = code + length;
 
-                    // then jump after the mark
-                    //
-                    f_it = et;
+            // trim exactly one space if one is found on each side
+            //
+            if(!blank
+            && result.length() > 2
+            && result.front() == ' '
+            && result.back() == ' ')
+            {
+                result = result.substr(1, result.length() - 2);
+            }
 
-                    // trim exactly one space if one is found on each side
-                    //
-                    if(!blank
-                    && result.length() > 2
-                    && result.front() == ' '
-                    && result.back() == ' ')
+            return "<code>" + result + "</code>";
+        }
+
+        /** \brief Search the closing mark of a code span.
+         *
+         * The first time this function gets called, it indexes all the
+         * runs of backticks found in the line by length. Later calls use
+         * a cursor per length which only moves forward, so each opening
+         * mark finds its closing mark (or learns that there is none) in
+         * amortized constant time instead of rescanning the rest of the
+         * paragraph.
+         *
+         * A closing mark has to be a run of exactly \p length backticks
+         * which starts at or after the current position.
+         *
+         * \param[in] length  The number of backticks in the opening mark.
+         *
+         * \return An iterator to the closing mark or f_line.cend().
+         */
+        character::string_t::const_iterator find_backtick_run(std::size_t length)
+        {
+            if(!f_backtick_runs_indexed)
+            {
+                f_backtick_runs_indexed = true;
+                for(auto it(f_line.cbegin()); it != f_line.cend(); )
+                {
+                    if(!it->is_grave())
                     {
-                        result = result.substr(1, result.length() - 2);
+                        ++it;
+                        continue;
                     }
-
-                    return "<code>" + result + "</code>";
+                    auto const run(it);
+                    for(++it; it != f_line.cend() && it->is_grave(); ++it);
+                    f_backtick_runs[it - run].f_positions.push_back(run - f_line.cbegin());
                 }
             }
 
-            return mark;
+            auto runs(f_backtick_runs.find(length));
+            if(runs == f_backtick_runs.end())
+            {
+                return f_line.cend();
+            }
+
+            std::vector<std::size_t> const & positions(runs->second.f_positions);
+            std::size_t & next(runs->second.f_next);
+            std::size_t const position(f_it - f_line.cbegin());
+            if(next > 0
+            && positions[next - 1] >= position)
+            {
+                // the iterator moved backward (rare), search again
+                //
+                next = std::lower_bound(positions.begin(), positions.end(), position) - positions.begin();
+            }
+            while(next < positions.size()
+               && positions[next] < position)
+            {
+                ++next;
+            }
+            if(next >= positions.size())
+            {
+                return f_line.cend();
+            }
+
+            return f_line.cbegin() + positions[next];
         }
 
         std::string convert_html_tag()
@@ -5031,9 +7716,13 @@ std::cerr << "---------------- convert HTML tag (inline)\n";
                         std::string result("<a href=\"");
 
                         character::string_t uri(f_it, et);
-                        result += convert_uri(uri);
+                        std::string destination(convert_uri(uri));
+                        std::string const attributes(rewrite_link(false, destination));
+                        result += destination;
 
-                        result += "\">";
+                        result += "\"";
+                        result += attributes;
+                        result += ">";
                         while(f_it != et)
                         {
                             result += convert_basic_char();
@@ -5049,6 +7738,29 @@ std::cerr << "---------------- convert HTML tag (inline)\n";
 
             // [REF] 6.6 Raw HTML
             //
+            if(f_sanitizer != nullptr)
+            {
+                std::string name;
+                bool closing(false);
+                tag_details_t details;
+                et = f_it;
+                if(parse_html_tag(f_line, et, name, closing, details))
+                {
+                    std::string const result(sanitize_tag(
+                              *f_sanitizer
+                            , name
+                            , closing
+                            , details
+                            , f_features.get_add_space_in_empty_tag()));
+                    if(!result.empty())
+                    {
+                        f_it = et;
+                        return result;
+                    }
+                }
+                return "&lt;";
+            }
+
             bool const closing(f_it->is_slash());
             et = f_it + (closing ? 1 : 0);
             if(et != f_line.cend()
@@ -5340,10 +8052,12 @@ std::cerr << ">>> not a link... return error [" << error_result << "]\n";
                 }
             }
 
-            result += is_image ? " src=\"" : " href=\"";
-            result += convert_uri(character::to_character_string(generate_attribute(
+            std::string destination(convert_uri(character::to_character_string(generate_attribute(
                                   character::to_character_string(link_destination)
-                                , f_features.get_convert_entities())));
+                                , f_features.get_convert_entities()))));
+            std::string const attributes(rewrite_link(is_image, destination));
+            result += is_image ? " src=\"" : " href=\"";
+            result += destination;
             result += "\"";
 
             if(is_image && !link_text.empty())
@@ -5364,6 +8078,7 @@ std::cerr << ">>> not a link... return error [" << error_result << "]\n";
                 result += "\"";
             }
 
+            result += attributes;
             result += ">";
 
             if(!is_image)
@@ -5373,7 +8088,11 @@ std::cerr << ">>> not a link... return error [" << error_result << "]\n";
                 inline_parser sub_parser(
                           character::to_character_string(link_text)
                         , f_features
-                        , f_find_link_reference);
+                        , f_find_link_reference
+                        , f_specials
+                        , f_triggers
+                        , f_link_rewriter
+                        , f_sanitizer);
                 result += sub_parser.run();
 
                 result += "</a>";
@@ -5382,6 +8101,22 @@ std::cerr << ">>> not a link... return error [" << error_result << "]\n";
             return result;
         }
 
+        std::string rewrite_link(bool is_image, std::string & destination)
+        {
+            if(f_sanitizer != nullptr
+            && !f_sanitizer->is_url_allowed(destination))
+            {
+                destination.clear();
+            }
+
+            std::string attributes;
+            if(f_link_rewriter != nullptr)
+            {
+                f_link_rewriter(is_image, destination, attributes);
+            }
+            return attributes;
+        }
+
         void parse_link_long_reference(
               character::string_t::const_iterator & et
             , std::string & link_reference)
@@ -5445,12 +8180,22 @@ std::cerr << ">>> not a link... return error [" << error_result << "]\n";
         std::string                             f_result = std::string();
         features                                f_features = features();
         link::find_link_reference_t             f_find_link_reference = link::find_link_reference_t();
+        inline_specials_t const &               f_specials;
+        inline_triggers_t const &               f_triggers;
+        link_rewriter_t const &                 f_link_rewriter;
+        sanitizer const *                       f_sanitizer = nullptr;
+        std::map<std::size_t, backtick_run_t>   f_backtick_runs = std::map<std::size_t, backtick_run_t>();
+        bool                                    f_backtick_runs_indexed = false;
     };
 
     inline_parser parser(
               line
             , f_features
-            , std::bind(&commonmark::find_link_reference, this, std::placeholders::_1));
+            , std::bind(&commonmark::find_link_reference, this, std::placeholders::_1)
+            , f_inline_specials
+            , f_inline_triggers
+            , f_link_rewriter
+            , f_sanitizer.get());
     f_output += parser.run();
 }
 
@@ -5459,6 +8204,7 @@ void commonmark::generate_code(block::pointer_t b)
 {
     f_output += "<code";
     character::string_t info(b->info_string());
+    code_renderer_t renderer;
     if(!info.empty())
     {
         // WARNING: this is to match the specs, they use the first parameter
@@ -5476,9 +8222,31 @@ void commonmark::generate_code(block::pointer_t b)
         f_output += " class=\"language-";
         f_output += generate_attribute(language, f_features.get_convert_entities());
         f_output += "\"";
+
+        if(!f_code_renderers.empty())
+        {
+            auto const r(f_code_renderers.find(character::to_utf8(language)));
+            if(r != f_code_renderers.end())
+            {
+                renderer = r->second;
+            }
+        }
     }
     f_output += ">";
     character::string_t const & line(b->content());
+    if(renderer != nullptr)
+    {
+        // the renderer does not get access to the HTML generated so far
+        //
+        std::string html;
+        renderer(
+              character::to_utf8(line)
+            , character::to_utf8(info)
+            , html);
+        f_output += html;
+        f_output += "</code>";
+        return;
+    }
     auto et(line.end());
     if(b->is_indented_code_block())
     {
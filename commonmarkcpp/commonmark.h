@@ -29,8 +29,16 @@
 // self
 //
 #include    "commonmarkcpp/block.h"
+#include    "commonmarkcpp/block_extension.h"
+#include    "commonmarkcpp/block_index.h"
 #include    "commonmarkcpp/features.h"
+#include    "commonmarkcpp/inline_extension.h"
 #include    "commonmarkcpp/link.h"
+#include    "commonmarkcpp/output_sink.h"
+#include    "commonmarkcpp/render_cache.h"
+#include    "commonmarkcpp/sanitizer.h"
+#include    "commonmarkcpp/streaming_hash.h"
+#include    "commonmarkcpp/utf8_input.h"
 
 
 // libutf8 lib
@@ -39,7 +47,12 @@
 
 // C++ lib
 //
+#include    <array>
+#include    <chrono>
+#include    <functional>
+#include    <map>
 #include    <memory>
+#include    <set>
 #include    <string>
 #include    <vector>
 
@@ -65,12 +78,84 @@ public:
     typedef std::shared_ptr<commonmark>
                             pointer_t;
 
+    struct block_hash_t
+    {
+        typedef std::vector<block_hash_t>   vector_t;
+
+        std::uint64_t       f_hash = 0;         // hash of the block HTML
+        std::size_t         f_offset = 0;       // offset of the block HTML in the output
+        std::size_t         f_size = 0;         // size of the block HTML in bytes
+    };
+
+    typedef std::function<void (
+                                  std::string const & code
+                                , std::string const & info_string
+                                , std::string & output)>
+                            code_renderer_t;
+
+    typedef std::function<void (
+                                  bool is_image
+                                , std::string & destination
+                                , std::string & attributes)>
+                            link_rewriter_t;
+
+    struct slow_document_t
+    {
+        std::size_t         f_input_size = 0;
+        std::uint64_t       f_input_hash = 0;                           // streaming_hash of the input
+        std::chrono::steady_clock::duration
+                            f_parse_duration = std::chrono::steady_clock::duration();
+        std::chrono::steady_clock::duration
+                            f_generate_duration = std::chrono::steady_clock::duration();
+        std::chrono::steady_clock::duration
+                            f_total_duration = std::chrono::steady_clock::duration();
+        std::size_t         f_block_count = 0;
+        std::size_t         f_max_depth = 0;                            // deepest nesting of blocks
+        std::string         f_quarantine_filename = std::string();      // empty if the input was not saved
+    };
+
+    typedef std::function<void (slow_document_t const & details)>
+                            slow_document_hook_t;
+
                             commonmark();
 
     void                    set_features(features const & features);
     features const &        get_features() const;
+    void                    add_inline_extension(inline_extension::pointer_t e);
+    void                    add_block_extension(block_extension::pointer_t e);
+    void                    set_code_renderer(std::string const & language, code_renderer_t renderer);
+    void                    set_link_rewriter(link_rewriter_t rewriter);
+    void                    set_sanitizer(sanitizer::pointer_t s);
+    void                    set_render_cache(render_cache::pointer_t cache);
+    void                    set_slow_document_hook(
+                                  std::chrono::steady_clock::duration threshold
+                                , slow_document_hook_t hook
+                                , std::string const & quarantine_directory = std::string());
 
     std::string             process(std::string const & input);
+    void                    process(std::string const & input, output_sink & sink);
+    std::string             process_inline(std::string const & input);
+
+    void                    set_build_block_index(bool build = true);
+    block_index const &     get_block_index() const;
+    std::string             process_blocks(
+                                  std::string const & input
+                                , block_index const & index
+                                , std::size_t first
+                                , std::size_t count);
+
+    void                    start();
+    std::string             add_input(std::string const & input);
+    std::string             finish();
+
+    void                    set_compute_block_hashes(bool compute = true);
+    block_hash_t::vector_t const &
+                            get_block_hashes() const;
+
+    void                    set_compute_output_hash(bool compute = true);
+    std::uint64_t           get_output_hash() const;
+    std::uint64_t           get_cache_key(std::string const & input) const;
+    std::uint64_t           fingerprint() const;
 
     void                    add_link(
                                   std::string const & name
@@ -84,12 +169,44 @@ private:
     {
         //typedef std::vector<input_status_t>     vector_t;
 
-        libutf8::utf8_iterator  f_iterator;
+        std::string::size_type  f_position = 0;
         std::uint32_t           f_line = 1;
         std::uint32_t           f_column = 1;
         character::string_t     f_last_line = character::string_t();
     };
 
+    struct generate_frame_t
+    {
+        typedef std::vector<generate_frame_t>   vector_t;
+
+        block::pointer_t        f_next = block::pointer_t();        // next block (or list item) to generate
+        std::string             f_close = std::string();            // HTML to output once done with this frame
+        std::string::size_type  f_start = std::string::npos;        // output offset of the current top-level block
+        char32_t                f_list_type = U'\0';                // type of list when generating list items
+        bool                    f_siblings = true;
+        bool                    f_top_level = false;
+        bool                    f_tight_list = false;
+    };
+
+    struct definition_t
+    {
+        typedef std::vector<definition_t>   vector_t;
+
+        std::uint32_t           f_line = 1;
+        std::string             f_name = std::string();
+        std::string             f_destination = std::string();
+        std::string             f_title = std::string();
+    };
+
+    struct segment_t
+    {
+        typedef std::vector<segment_t>      vector_t;
+
+        block::pointer_t        f_block = block::pointer_t();
+        std::string             f_html = std::string();
+        std::set<std::string>   f_unresolved_references = std::set<std::string>();
+    };
+
     character               getc();
     void                    get_line();
     input_status_t          get_current_status();
@@ -122,17 +239,46 @@ private:
     bool                    process_indented_code_block(character::string_t::const_iterator & it);
     bool                    process_fenced_code_block(character::string_t::const_iterator & it);
     bool                    process_html_blocks(character::string_t::const_iterator & it);
+    bool                    process_block_extensions(character::string_t::const_iterator & it);
+    static void             insert_link(
+                                  link::map_t & links
+                                , std::string const & name
+                                , std::string const & destination
+                                , std::string const & title
+                                , bool reference);
+    void                    reset_links();
+    void                    build_block_tables();
+    void                    index_blocks();
+    void                    parse_pending_input(std::string::size_type size, bool last);
+    block::pointer_t        generate_segment(segment_t & s);
+    std::string             release_segments(bool all);
 
     void                    generate(block::pointer_t b);
-    void                    generate_list(block::pointer_t & b);
+    void                    generate_block(block::pointer_t & b);
+    void                    generate_top_level_block(block::pointer_t & b);
+    void                    add_block_hash(std::string::size_type start);
+    void                    flush_output();
+    void                    report_slow_document(
+                                  std::string const & input
+                                , std::chrono::steady_clock::duration parse_duration
+                                , std::chrono::steady_clock::duration generate_duration
+                                , std::chrono::steady_clock::duration total_duration);
+    void                    generate_blocks(block::pointer_t b, bool siblings);
+    void                    generate_block_start(block::pointer_t b);
+    void                    generate_list(block::pointer_t b);
+    void                    generate_list_item(block::pointer_t b, bool tight_list);
     void                    generate_header(block::pointer_t b);
     std::string             to_identifier(character::string_t const & line);
     void                    generate_thematic_break(block::pointer_t b);
+    void                    build_inline_tables();
+    void                    build_plain_text_table();
+    bool                    is_plain_text(std::string const & input) const;
+    void                    generate_plain_text(std::string const & input);
     void                    generate_inline(character::string_t const & line);
     void                    generate_code(block::pointer_t b);
 
     std::string             f_input = std::string();
-    libutf8::utf8_iterator  f_iterator;  // must be defined in constructors
+    utf8_input              f_utf8_input = utf8_input();
     std::uint32_t           f_line = 1;
     std::uint32_t           f_column = 1;
     //input_status_t::vector_t
@@ -142,6 +288,10 @@ private:
     //character_t             f_unget[2] = {};
     bool                    f_eos = false;
     bool                    f_code_block = false;
+    bool                    f_build_block_index = false;
+    bool                    f_compute_block_hashes = false;
+    bool                    f_compute_output_hash = false;
+    bool                    f_streaming = false;
     std::uint32_t           f_list_subblock = 0;
     features                f_features = features();
     character::string_t     f_last_line = character::string_t();
@@ -152,9 +302,48 @@ private:
     block::pointer_t        f_top_working_block = block::pointer_t();
     block::pointer_t        f_working_block = block::pointer_t();
 
+    block_extension::vector_t
+                            f_block_extensions = block_extension::vector_t();
+    std::array<bool, 128>   f_block_starters = std::array<bool, 128>();
+    std::array<block_extension::vector_t, 128>
+                            f_block_triggers = std::array<block_extension::vector_t, 128>();
+    std::map<std::string, code_renderer_t>
+                            f_code_renderers = std::map<std::string, code_renderer_t>();
+    link_rewriter_t         f_link_rewriter = link_rewriter_t();
+    sanitizer::pointer_t    f_sanitizer = sanitizer::pointer_t();
+    render_cache::pointer_t f_render_cache = render_cache::pointer_t();
+    std::chrono::steady_clock::duration
+                            f_slow_document_threshold = std::chrono::steady_clock::duration();
+    slow_document_hook_t    f_slow_document_hook = slow_document_hook_t();
+    std::string             f_quarantine_directory = std::string();
+    inline_extension::vector_t
+                            f_inline_extensions = inline_extension::vector_t();
+    std::array<bool, 128>   f_inline_specials = std::array<bool, 128>();
+    std::array<inline_extension::vector_t, 128>
+                            f_inline_triggers = std::array<inline_extension::vector_t, 128>();
+    std::array<std::uint8_t, 256>
+                            f_plain_text_table = std::array<std::uint8_t, 256>();
+
+    link::map_t             f_user_links = link::map_t();
     link::map_t             f_links = link::map_t();
+    block_index             f_block_index = block_index();
+    block_hash_t::vector_t  f_block_hashes = block_hash_t::vector_t();
+    std::set<std::string>   f_unresolved_references = std::set<std::string>();
+
+    std::string             f_pending_input = std::string();
+    std::uint32_t           f_pending_line = 1;
+    std::string::size_type  f_next_parse_size = 0;
+    bool                    f_pending_paragraph = false;
+    segment_t::vector_t     f_segments = segment_t::vector_t();
+    definition_t::vector_t  f_definitions = definition_t::vector_t();
 
     std::string             f_output = std::string();
+    output_sink *           f_sink = nullptr;
+    std::size_t             f_flushed_size = 0;
+    std::string::size_type  f_hashed_size = 0;
+    streaming_hash          f_output_hash = streaming_hash();
+    generate_frame_t::vector_t
+                            f_generate_stack = generate_frame_t::vector_t();
 };
 
 
@@ -0,0 +1,275 @@
+// Copyright (c) 2021-2022  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/commonmarkcpp
+// contact@m2osw.com
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+/** \file
+ * \brief Implementation of the deflate_sink class.
+ *
+ * The deflate_sink uses zlib to compress the output in a streaming
+ * manner. The compressor keeps its own window so the result is the same
+ * as compressing the whole document at once with the same settings,
+ * only the peak memory is much smaller since the uncompressed document
+ * never needs to be fully in memory.
+ */
+
+// self
+//
+#include    "commonmarkcpp/deflate_sink.h"
+
+#include    "commonmarkcpp/exception.h"
+
+
+// C++ lib
+//
+#include    <algorithm>
+#include    <cstring>
+
+
+// C lib
+//
+#include    <zlib.h>
+
+
+// last include
+//
+#include    <snapdev/poison.h>
+
+
+
+namespace cm
+{
+
+
+
+namespace
+{
+
+
+
+constexpr std::size_t       g_buffer_size = 16 * 1024;
+
+
+
+}
+// no name namespace
+
+
+
+/** \brief Initialize the compressor.
+ *
+ * The compressed data gets written to the \p next sink. The finish()
+ * function of the \p next sink is called by our own finish() function.
+ *
+ * The \p format defines the headers added around the deflate data. Use
+ * DEFLATE_FORMAT_GZIP for a "Content-Encoding: gzip" and
+ * DEFLATE_FORMAT_ZLIB for a "Content-Encoding: deflate".
+ *
+ * \exception unexpected_null_pointer
+ * The \p next sink is required.
+ *
+ * \exception commonmark_out_of_range
+ * The \p level must be DEFAULT_LEVEL or a number from 0 to 9.
+ *
+ * \exception compression_error
+ * This exception is raised if zlib can't be initialized.
+ *
+ * \param[in] next  The sink receiving the compressed data.
+ * \param[in] format  The format of the compressed data.
+ * \param[in] level  The compression level (0 to 9).
+ */
+deflate_sink::deflate_sink(
+          output_sink::pointer_t next
+        , deflate_format_t format
+        , int level)
+    : f_next(next)
+    , f_stream(std::make_unique<z_stream_s>())
+    , f_buffer(g_buffer_size)
+{
+    if(f_next == nullptr)
+    {
+        throw unexpected_null_pointer("deflate_sink requires a next output sink.");
+    }
+    if(level != DEFAULT_LEVEL
+    && (level < 0 || level > 9))
+    {
+        throw commonmark_out_of_range(
+                  "deflate_sink compression level ("
+                + std::to_string(level)
+                + ") must be between 0 and 9.");
+    }
+
+    int window_bits(15);
+    switch(format)
+    {
+    case deflate_format_t::DEFLATE_FORMAT_ZLIB:
+        break;
+
+    case deflate_format_t::DEFLATE_FORMAT_GZIP:
+        window_bits += 16;
+        break;
+
+    case deflate_format_t::DEFLATE_FORMAT_RAW:
+        window_bits = -window_bits;
+        break;
+
+    }
+
+    memset(f_stream.get(), 0, sizeof(z_stream_s));
+    int const r(deflateInit2(
+                      f_stream.get()
+                    , level == DEFAULT_LEVEL ? Z_DEFAULT_COMPRESSION : level
+                    , Z_DEFLATED
+                    , window_bits
+                    , 8
+                    , Z_DEFAULT_STRATEGY));
+    if(r != Z_OK)
+    {
+        f_stream.reset();
+        throw compression_error("deflateInit2() failed initializing the deflate_sink.");
+    }
+}
+
+
+/** \brief Release the compressor.
+ *
+ * If finish() was not called, the compressed data is incomplete and
+ * gets lost.
+ */
+deflate_sink::~deflate_sink()
+{
+    if(f_stream != nullptr)
+    {
+        deflateEnd(f_stream.get());
+    }
+}
+
+
+/** \brief Compress a chunk of data.
+ *
+ * The data is compressed and the compressed data is written to the
+ * next sink whenever our output buffer is full.
+ *
+ * \exception already_flushed
+ * This exception is raised if the function gets called after finish().
+ *
+ * \param[in] data  The data to compress.
+ * \param[in] size  The number of bytes in \p data.
+ */
+void deflate_sink::write(char const * data, std::size_t size)
+{
+    if(f_finished)
+    {
+        throw already_flushed("deflate_sink::write() called after finish().");
+    }
+
+    f_total_in += size;
+    compress(data, size, Z_NO_FLUSH);
+}
+
+
+/** \brief Terminate the compressed stream.
+ *
+ * This function flushes the data still in the compressor, writes the
+ * trailer (checksum) and calls the finish() function of the next sink.
+ *
+ * Calling finish() more than once has no effect.
+ */
+void deflate_sink::finish()
+{
+    if(f_finished)
+    {
+        return;
+    }
+    f_finished = true;
+
+    compress(nullptr, 0, Z_FINISH);
+    f_next->finish();
+}
+
+
+/** \brief Number of bytes written to the compressor.
+ *
+ * \return The number of uncompressed bytes received so far.
+ */
+std::uint64_t deflate_sink::total_in() const
+{
+    return f_total_in;
+}
+
+
+/** \brief Number of compressed bytes sent to the next sink.
+ *
+ * \return The number of compressed bytes written so far.
+ */
+std::uint64_t deflate_sink::total_out() const
+{
+    return f_total_out;
+}
+
+
+/** \brief Run the compressor.
+ *
+ * zlib uses 32 bit sizes so large chunks get compressed in several
+ * passes.
+ *
+ * \param[in] data  The data to compress.
+ * \param[in] size  The number of bytes in \p data.
+ * \param[in] flush  Z_NO_FLUSH or Z_FINISH.
+ */
+void deflate_sink::compress(char const * data, std::size_t size, int flush)
+{
+    z_stream_s * s(f_stream.get());
+    for(;;)
+    {
+        uInt const chunk(static_cast<uInt>(std::min<std::size_t>(size, 0x40000000)));
+        s->next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+        s->avail_in = chunk;
+        data += chunk;
+        size -= chunk;
+
+        int const f(size == 0 ? flush : Z_NO_FLUSH);
+        int r(Z_OK);
+        do
+        {
+            s->next_out = reinterpret_cast<Bytef *>(f_buffer.data());
+            s->avail_out = static_cast<uInt>(f_buffer.size());
+            r = deflate(s, f);
+            if(r == Z_STREAM_ERROR)
+            {
+                throw compression_error("deflate() failed compressing the output.");
+            }
+            std::size_t const out(f_buffer.size() - s->avail_out);
+            if(out > 0)
+            {
+                f_total_out += out;
+                f_next->write(f_buffer.data(), out);
+            }
+        }
+        while(s->avail_out == 0 || (f == Z_FINISH && r != Z_STREAM_END));
+
+        if(size == 0)
+        {
+            break;
+        }
+    }
+}
+
+
+
+} // namespace cm
+// vim: ts=4 sw=4 et
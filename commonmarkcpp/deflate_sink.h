@@ -0,0 +1,96 @@
+// Copyright (c) 2021-2022  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/commonmarkcpp
+// contact@m2osw.com
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+#pragma once
+
+/** \file
+ * \brief Declaration of the deflate_sink class.
+ *
+ * The deflate_sink compresses the data it receives with zlib and sends
+ * the compressed data to another sink. This way the HTML gets compressed
+ * as it is generated instead of in a second pass over the whole output.
+ */
+
+
+// self
+//
+#include    "commonmarkcpp/output_sink.h"
+
+
+// C++ lib
+//
+#include    <cstdint>
+#include    <vector>
+
+
+
+struct z_stream_s;
+
+
+
+namespace cm
+{
+
+
+
+enum class deflate_format_t
+{
+    DEFLATE_FORMAT_ZLIB,        // zlib header and adler32 checksum
+    DEFLATE_FORMAT_GZIP,        // gzip header and crc32 checksum
+    DEFLATE_FORMAT_RAW,         // raw deflate data (HTTP "deflate" is zlib)
+};
+
+
+class deflate_sink
+    : public output_sink
+{
+public:
+    typedef std::shared_ptr<deflate_sink>
+                            pointer_t;
+
+    static int const        DEFAULT_LEVEL = -1;
+
+                            deflate_sink(
+                                  output_sink::pointer_t next
+                                , deflate_format_t format = deflate_format_t::DEFLATE_FORMAT_GZIP
+                                , int level = DEFAULT_LEVEL);
+    virtual                 ~deflate_sink() override;
+
+    virtual void            write(char const * data, std::size_t size) override;
+    using output_sink::write;
+    virtual void            finish() override;
+
+    std::uint64_t           total_in() const;
+    std::uint64_t           total_out() const;
+
+private:
+    void                    compress(char const * data, std::size_t size, int flush);
+
+    output_sink::pointer_t  f_next = output_sink::pointer_t();
+    std::unique_ptr<z_stream_s>
+                            f_stream = std::unique_ptr<z_stream_s>();
+    std::vector<char>       f_buffer = std::vector<char>();
+    std::uint64_t           f_total_in = 0;
+    std::uint64_t           f_total_out = 0;
+    bool                    f_finished = false;
+};
+
+
+
+} // namespace cm
+// vim: ts=4 sw=4 et
@@ -43,6 +43,8 @@ DECLARE_OUT_OF_RANGE(commonmark_out_of_range);
 DECLARE_MAIN_EXCEPTION(commonmark_error);
 
 DECLARE_EXCEPTION(commonmark_error, already_flushed);
+DECLARE_EXCEPTION(commonmark_error, compression_error);
+DECLARE_EXCEPTION(commonmark_error, render_cache_error);
 DECLARE_EXCEPTION(commonmark_error, unexpected_null_pointer);
 //DECLARE_EXCEPTION(commonmark_error, invalid_variable);
 //DECLARE_EXCEPTION(commonmark_error, invalid_parameter);
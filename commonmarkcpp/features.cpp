@@ -35,6 +35,9 @@
 //
 #include    "commonmarkcpp/features.h"
 
+#include    "commonmarkcpp/streaming_hash.h"
+#include    "commonmarkcpp/version.h"
+
 
 // C++ lib
 //
@@ -252,6 +255,46 @@ std::string const & features::get_line_feed() const
 }
 
 
+/** \brief Compute a fingerprint of these features.
+ *
+ * This function returns a hash of all the options defined in this
+ * features object. Two features objects with the same fingerprint
+ * generate the same HTML from the same input, so the fingerprint can be
+ * used as part of a cache key.
+ *
+ * The version of the library is included in the fingerprint since a new
+ * version may generate different HTML with the same options. This means
+ * caches get invalidated when the library gets upgraded.
+ *
+ * \note
+ * When adding a new option, it must be added to the fingerprint too.
+ *
+ * \return A 64 bit hash representing these features.
+ *
+ * \sa commonmark::fingerprint()
+ */
+std::uint64_t features::fingerprint() const
+{
+    streaming_hash h;
+
+    h.add(COMMONMARKCPP_VERSION_STRING, sizeof(COMMONMARKCPP_VERSION_STRING));
+
+    char const options[] =
+    {
+        f_add_document_div          ? '1' : '0',
+        f_add_classes               ? '1' : '0',
+        f_add_space_in_empty_tag    ? '1' : '0',
+        f_convert_entities          ? '1' : '0',
+        f_ins_del_extension         ? '1' : '0',
+        f_remove_unknown_references ? '1' : '0',
+    };
+    h.add(options, sizeof(options));
+    h.add(f_line_feed);
+
+    return h.digest();
+}
+
+
 
 } // namespace cm
 // vim: ts=4 sw=4 et
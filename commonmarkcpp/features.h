@@ -33,6 +33,7 @@
 
 // C++ lib
 //
+#include    <cstdint>
 #include    <memory>
 #include    <string>
 
@@ -72,6 +73,8 @@ public:
     void                    set_line_feed(std::string const & line_feed);
     std::string const &     get_line_feed() const;
 
+    std::uint64_t           fingerprint() const;
+
 private:
     bool                    f_add_document_div = false;
     bool                    f_add_classes = false;
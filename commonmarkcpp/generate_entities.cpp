@@ -66,6 +66,7 @@
 // C++
 //
 #include    <iomanip>
+#include    <sstream>
 
 
 // last include
@@ -504,45 +505,69 @@ int entities::output_table_cpp()
     std::string header_filename(snapdev::pathinfo::replace_suffix(f_output_filename, ".cpp", ".h"));
     std::ofstream hdr(header_filename);
 
+    // the names and codes are saved in one large string and the table
+    // only holds offsets in that string; this way the table has no
+    // pointers so it does not need to be relocated when the library
+    // gets loaded and it stays in pages shared between processes
+    //
     hdr << "#pragma once\n"
         << "#include <cstddef>\n"
+        << "#include <cstdint>\n"
         << "namespace cm {\n"
         << "struct entity_t {\n"
-        << "char const * const f_name;\n"
-        << "char const * const f_codes;\n"
+        << "std::uint32_t const f_name;\n"
+        << "std::uint32_t const f_codes;\n"
         << "};\n"
         << "constexpr std::size_t const ENTITY_COUNT = "
                                 << f_entities.size() << ";\n"
         << "extern entity_t const g_entities[];\n"
+        << "extern char const g_entity_strings[];\n"
+        << "inline char const * entity_name(entity_t const & e) { return g_entity_strings + e.f_name; }\n"
+        << "inline char const * entity_codes(entity_t const & e) { return g_entity_strings + e.f_codes; }\n"
         << "} // namespace cm\n";
 
     std::ofstream out(f_output_filename);
 
-    out << std::hex;
-
     out << "#include \"" << header_filename << "\"\n"
         << "namespace cm {\n"
         << "entity_t const g_entities[] = {\n";
+    std::string strings;
+    std::uint32_t offset(0);
     for(auto e : f_entities)
     {
         std::string name(e->get_name());
-        out << "{ \""
-            << name.substr(1, name.length() - 2)
-            << "\", \"";
+        name = name.substr(1, name.length() - 2);
+        std::string const codes(e->get_codes());
 
-        std::string codes(e->get_codes());
+        out << "{ " << offset;
+        offset += name.length() + 1;
+        out << ", " << offset << " },\n";
+        offset += codes.length() + 1;
+
+        // each string is a separate literal so a "\0" never gets merged
+        // with the following characters
+        //
+        strings += '"';
+        strings += name;
+        strings += "\\0\" \"";
+
+        std::stringstream hex;
+        hex << std::hex;
         std::size_t const max(codes.length());
         for(std::size_t idx(0); idx < max; ++idx)
         {
-            out << "\\x"
+            hex << "\\x"
                 << std::setw(2)
                 << std::setfill('0')
                 << static_cast<int>(static_cast<std::uint8_t>(codes[idx]));
         }
-
-        out << "\" },\n";
+        strings += hex.str();
+        strings += "\\0\"\n";
     }
     out << "};\n"
+        << "char const g_entity_strings[] =\n"
+        << strings
+        << ";\n"
         << "} // namespace cm\n";
 
     return 0;
@@ -0,0 +1,136 @@
+// Copyright (c) 2021-2022  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/commonmarkcpp
+// contact@m2osw.com
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+/** \file
+ * \brief Implementation of the inline_extension class.
+ *
+ * The inline_extension is the base class of all the inline extensions.
+ * It holds the list of characters which trigger a call to the convert()
+ * function of the extension.
+ */
+
+// self
+//
+#include    "commonmarkcpp/inline_extension.h"
+
+#include    "commonmarkcpp/exception.h"
+
+
+// C++ lib
+//
+#include    <typeinfo>
+
+
+// last include
+//
+#include    <snapdev/poison.h>
+
+
+
+namespace cm
+{
+
+
+
+/** \brief Initialize the extension with its trigger characters.
+ *
+ * The \p triggers string lists the characters which may start the syntax
+ * supported by this extension. The inline parser calls the convert()
+ * function only when it finds one of those characters.
+ *
+ * Only visible ASCII characters (0x21 to 0x7E) can be used as triggers.
+ *
+ * \exception commonmark_out_of_range
+ * This exception is raised if \p triggers is empty or includes a character
+ * which is not a visible ASCII character.
+ *
+ * \param[in] triggers  The characters which start this extension syntax.
+ */
+inline_extension::inline_extension(std::string const & triggers)
+    : f_triggers(triggers)
+{
+    if(f_triggers.empty())
+    {
+        throw commonmark_out_of_range("an inline extension needs at least one trigger character.");
+    }
+    for(auto const c : f_triggers)
+    {
+        if(c < 0x21 || c > 0x7E)
+        {
+            throw commonmark_out_of_range("inline extension trigger characters must be visible ASCII characters.");
+        }
+    }
+}
+
+
+inline_extension::~inline_extension()
+{
+}
+
+
+/** \brief Get the trigger characters of this extension.
+ *
+ * \return The string of characters passed to the constructor.
+ */
+std::string const & inline_extension::triggers() const
+{
+    return f_triggers;
+}
+
+
+/** \brief Get a string identifying this extension.
+ *
+ * The identity is used to compute the fingerprint of a commonmark object
+ * (see commonmark::fingerprint()). The default is the name of the type
+ * of the extension followed by its trigger characters.
+ *
+ * An extension which accepts options changing its output must override
+ * this function and add those options to the identity so different
+ * settings give different fingerprints.
+ *
+ * \return A string identifying this extension and its settings.
+ */
+std::string inline_extension::identity() const
+{
+    return std::string(typeid(*this).name()) + ':' + f_triggers;
+}
+
+
+/** \fn inline_extension::convert(character::string_t const & line, character::string_t::const_iterator & it, std::string & result)
+ * \brief Convert the extension syntax found at \p it.
+ *
+ * This function is called with \p it pointing to one of the trigger
+ * characters. If the characters at that position match the extension
+ * syntax, the function appends the corresponding HTML to \p result,
+ * moves \p it past the characters it used and returns true.
+ *
+ * Otherwise it returns false and the character gets processed as usual
+ * (or by the next extension registered with the same trigger).
+ *
+ * \param[in] line  The inline content being converted.
+ * \param[in,out] it  The position of the trigger character in \p line.
+ * \param[out] result  The string where the HTML gets appended.
+ *
+ * \return true if the extension converted some of the input.
+ */
+
+
+
+} // namespace cm
+// vim: ts=4 sw=4 et
@@ -0,0 +1,349 @@
+// Copyright (c) 2021-2022  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/commonmarkcpp
+// contact@m2osw.com
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+/** \file
+ * \brief Implementation of the metrics class.
+ *
+ * Each thread updates its own block of counters. The blocks are kept in
+ * a lock-free list which gets walked when the metrics are rendered, the
+ * counters of all the blocks being added together. The owner of a block
+ * is the only writer so a counter update is a relaxed atomic add on a
+ * cache line no other thread writes to.
+ *
+ * When a thread exits, its block is released but kept in the list so
+ * its counts are not lost. The next new thread reuses it.
+ */
+
+// self
+//
+#include    "commonmarkcpp/metrics.h"
+
+
+// C++ lib
+//
+#include    <atomic>
+#include    <iomanip>
+#include    <sstream>
+
+
+// last include
+//
+#include    <snapdev/poison.h>
+
+
+
+namespace cm
+{
+
+
+
+namespace
+{
+
+
+
+constexpr double const  g_buckets[] =
+{
+    0.0001, 0.00025, 0.0005,
+    0.001, 0.0025, 0.005,
+    0.01, 0.025, 0.05,
+    0.1, 0.25, 0.5,
+    1.0, 2.5, 5.0,
+    10.0,
+};
+
+constexpr std::size_t const g_bucket_count = sizeof(g_buckets) / sizeof(g_buckets[0]);
+
+constexpr std::size_t const g_phase_count = static_cast<std::size_t>(metrics_phase_t::METRICS_PHASE_COUNT);
+
+char const * const      g_phase_names[g_phase_count] =
+{
+    "parse",
+    "generate",
+    "total",
+};
+
+
+struct histogram_t
+{
+    std::atomic<std::uint64_t>  f_buckets[g_bucket_count + 1] = {};    // the last one is +Inf
+    std::atomic<std::uint64_t>  f_sum = 0;                              // in nanoseconds
+};
+
+
+struct alignas(64) counters_t
+{
+    std::atomic<counters_t *>   f_next = nullptr;
+    std::atomic<bool>           f_in_use = true;
+
+    std::atomic<std::uint64_t>  f_documents = 0;
+    std::atomic<std::uint64_t>  f_input_bytes = 0;
+    std::atomic<std::uint64_t>  f_output_bytes = 0;
+    std::atomic<std::uint64_t>  f_cache_hits = 0;
+    std::atomic<std::uint64_t>  f_cache_misses = 0;
+    histogram_t                 f_durations[g_phase_count] = {};
+};
+
+
+std::atomic<counters_t *>   g_head = nullptr;
+
+
+void add(std::atomic<std::uint64_t> & counter, std::uint64_t value)
+{
+    // only the owner thread writes to its counters
+    //
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+
+/** \brief Get a block of counters for the current thread.
+ *
+ * A released block is reused if available. Otherwise a new block gets
+ * allocated and pushed at the front of the list. Blocks are never freed.
+ *
+ * \return A block of counters used only by the calling thread.
+ */
+counters_t * acquire()
+{
+    for(counters_t * c(g_head.load(std::memory_order_acquire));
+        c != nullptr;
+        c = c->f_next.load(std::memory_order_acquire))
+    {
+        bool expected(false);
+        if(c->f_in_use.compare_exchange_strong(expected, true, std::memory_order_acquire))
+        {
+            return c;
+        }
+    }
+
+    counters_t * c(new counters_t);
+    counters_t * head(g_head.load(std::memory_order_relaxed));
+    do
+    {
+        c->f_next.store(head, std::memory_order_relaxed);
+    }
+    while(!g_head.compare_exchange_weak(head, c, std::memory_order_release, std::memory_order_relaxed));
+
+    return c;
+}
+
+
+class thread_counters
+{
+public:
+    thread_counters()
+        : f_counters(acquire())
+    {
+    }
+
+    thread_counters(thread_counters const &) = delete;
+    thread_counters & operator = (thread_counters const &) = delete;
+
+    ~thread_counters()
+    {
+        f_counters->f_in_use.store(false, std::memory_order_release);
+    }
+
+    counters_t *    f_counters = nullptr;
+};
+
+
+counters_t & counters()
+{
+    thread_local thread_counters c;
+    return *c.f_counters;
+}
+
+
+std::uint64_t sum(std::atomic<std::uint64_t> counters_t::*field)
+{
+    std::uint64_t result(0);
+    for(counters_t * c(g_head.load(std::memory_order_acquire));
+        c != nullptr;
+        c = c->f_next.load(std::memory_order_acquire))
+    {
+        result += (c->*field).load(std::memory_order_relaxed);
+    }
+    return result;
+}
+
+
+void output_counter(std::ostream & out, char const * name, char const * help, std::uint64_t value)
+{
+    out << "# HELP " << name << ' ' << help << '\n'
+        << "# TYPE " << name << " counter\n"
+        << name << ' ' << value << '\n';
+}
+
+
+
+}
+// no name namespace
+
+
+
+/** \brief Count one more document.
+ *
+ * \param[in] input_size  The size of the input in bytes.
+ * \param[in] output_size  The size of the output in bytes.
+ */
+void metrics::add_document(std::size_t input_size, std::size_t output_size)
+{
+    counters_t & c(counters());
+    add(c.f_documents, 1);
+    add(c.f_input_bytes, input_size);
+    add(c.f_output_bytes, output_size);
+}
+
+
+/** \brief Add the duration of one phase to its histogram.
+ *
+ * \param[in] phase  The phase which took \p duration.
+ * \param[in] duration  The time it took.
+ */
+void metrics::add_duration(metrics_phase_t phase, std::chrono::steady_clock::duration duration)
+{
+    std::size_t const p(static_cast<std::size_t>(phase));
+    if(p >= g_phase_count)
+    {
+        return;
+    }
+
+    double const seconds(std::chrono::duration<double>(duration).count());
+    std::size_t bucket(0);
+    while(bucket < g_bucket_count
+       && seconds > g_buckets[bucket])
+    {
+        ++bucket;
+    }
+
+    histogram_t & h(counters().f_durations[p]);
+    add(h.f_buckets[bucket], 1);
+    add(h.f_sum, std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+}
+
+
+/** \brief Count a document found in the render cache.
+ */
+void metrics::add_cache_hit()
+{
+    add(counters().f_cache_hits, 1);
+}
+
+
+/** \brief Count a document not found in the render cache.
+ */
+void metrics::add_cache_miss()
+{
+    add(counters().f_cache_misses, 1);
+}
+
+
+/** \brief Render the metrics in the Prometheus text format.
+ *
+ * The counters of all the threads are added together. The result can be
+ * returned as is by an HTTP endpoint scraped by Prometheus (content
+ * type "text/plain; version=0.0.4").
+ *
+ * \return The metrics in the Prometheus text exposition format.
+ */
+std::string metrics::to_prometheus()
+{
+    std::ostringstream out;
+
+    output_counter(out, "commonmark_documents_total", "Number of documents processed.", sum(&counters_t::f_documents));
+    output_counter(out, "commonmark_input_bytes_total", "Number of markdown bytes processed.", sum(&counters_t::f_input_bytes));
+    output_counter(out, "commonmark_output_bytes_total", "Number of HTML bytes generated.", sum(&counters_t::f_output_bytes));
+    output_counter(out, "commonmark_cache_hits_total", "Number of documents found in the render cache.", sum(&counters_t::f_cache_hits));
+    output_counter(out, "commonmark_cache_misses_total", "Number of documents not found in the render cache.", sum(&counters_t::f_cache_misses));
+
+    char const * const name("commonmark_phase_duration_seconds");
+    out << "# HELP " << name << " Time spent in each phase of process().\n"
+        << "# TYPE " << name << " histogram\n";
+    for(std::size_t p(0); p < g_phase_count; ++p)
+    {
+        std::uint64_t buckets[g_bucket_count + 1] = {};
+        std::uint64_t sum_ns(0);
+        for(counters_t * c(g_head.load(std::memory_order_acquire));
+            c != nullptr;
+            c = c->f_next.load(std::memory_order_acquire))
+        {
+            histogram_t const & h(c->f_durations[p]);
+            for(std::size_t b(0); b <= g_bucket_count; ++b)
+            {
+                buckets[b] += h.f_buckets[b].load(std::memory_order_relaxed);
+            }
+            sum_ns += h.f_sum.load(std::memory_order_relaxed);
+        }
+
+        std::uint64_t count(0);
+        for(std::size_t b(0); b <= g_bucket_count; ++b)
+        {
+            count += buckets[b];
+            out << name << "_bucket{phase=\"" << g_phase_names[p] << "\",le=\"";
+            if(b < g_bucket_count)
+            {
+                out << g_buckets[b];
+            }
+            else
+            {
+                out << "+Inf";
+            }
+            out << "\"} " << count << '\n';
+        }
+        out << name << "_sum{phase=\"" << g_phase_names[p] << "\"} "
+            << std::setprecision(9) << static_cast<double>(sum_ns) / 1e9 << std::setprecision(6) << '\n'
+            << name << "_count{phase=\"" << g_phase_names[p] << "\"} " << count << '\n';
+    }
+
+    return out.str();
+}
+
+
+/** \brief Reset all the counters to zero.
+ *
+ * This is mainly useful in tests. The counters of the threads which are
+ * currently processing a document may not be fully reset.
+ */
+void metrics::reset()
+{
+    for(counters_t * c(g_head.load(std::memory_order_acquire));
+        c != nullptr;
+        c = c->f_next.load(std::memory_order_acquire))
+    {
+        c->f_documents.store(0, std::memory_order_relaxed);
+        c->f_input_bytes.store(0, std::memory_order_relaxed);
+        c->f_output_bytes.store(0, std::memory_order_relaxed);
+        c->f_cache_hits.store(0, std::memory_order_relaxed);
+        c->f_cache_misses.store(0, std::memory_order_relaxed);
+        for(auto & h : c->f_durations)
+        {
+            for(auto & b : h.f_buckets)
+            {
+                b.store(0, std::memory_order_relaxed);
+            }
+            h.f_sum.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+
+
+} // namespace cm
+// vim: ts=4 sw=4 et
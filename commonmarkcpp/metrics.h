@@ -0,0 +1,68 @@
+// Copyright (c) 2021-2022  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/commonmarkcpp
+// contact@m2osw.com
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+#pragma once
+
+/** \file
+ * \brief Declaration of the metrics class.
+ *
+ * The metrics class collects statistics about the documents processed
+ * by all the commonmark objects of the process and renders them in the
+ * Prometheus text format.
+ */
+
+
+// C++ lib
+//
+#include    <chrono>
+#include    <cstdint>
+#include    <string>
+
+
+
+namespace cm
+{
+
+
+
+enum class metrics_phase_t
+{
+    METRICS_PHASE_PARSE,
+    METRICS_PHASE_GENERATE,
+    METRICS_PHASE_TOTAL,
+
+    METRICS_PHASE_COUNT
+};
+
+
+class metrics
+{
+public:
+    static void             add_document(std::size_t input_size, std::size_t output_size);
+    static void             add_duration(metrics_phase_t phase, std::chrono::steady_clock::duration duration);
+    static void             add_cache_hit();
+    static void             add_cache_miss();
+
+    static std::string      to_prometheus();
+    static void             reset();
+};
+
+
+
+} // namespace cm
+// vim: ts=4 sw=4 et
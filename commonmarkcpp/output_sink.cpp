@@ -0,0 +1,92 @@
+// Copyright (c) 2021-2022  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/commonmarkcpp
+// contact@m2osw.com
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+/** \file
+ * \brief Implementation of the output_sink class.
+ *
+ * The output_sink is the base class of all the sinks. The write()
+ * function receives the HTML in chunks and the finish() function gets
+ * called once the whole document was written.
+ */
+
+// self
+//
+#include    "commonmarkcpp/output_sink.h"
+
+
+// last include
+//
+#include    <snapdev/poison.h>
+
+
+
+namespace cm
+{
+
+
+
+output_sink::output_sink()
+{
+}
+
+
+output_sink::~output_sink()
+{
+}
+
+
+/** \brief Write a string to the sink.
+ *
+ * This is a helper function which calls the virtual write() function
+ * with the data and size of the \p data string.
+ *
+ * \param[in] data  The data to write.
+ */
+void output_sink::write(std::string const & data)
+{
+    write(data.data(), data.length());
+}
+
+
+/** \fn output_sink::write(char const * data, std::size_t size)
+ * \brief Write a chunk of HTML to the sink.
+ *
+ * The commonmark object calls this function each time a top-level block
+ * was generated. The chunks are not guaranteed to end on a line boundary.
+ *
+ * \param[in] data  The data to write.
+ * \param[in] size  The number of bytes in \p data.
+ */
+
+
+/** \brief Let the sink know that the document is complete.
+ *
+ * This function is called once the whole document was written to the
+ * sink. A sink which buffers data (i.e. a compressor) must flush it.
+ *
+ * The default implementation does nothing.
+ */
+void output_sink::finish()
+{
+}
+
+
+
+} // namespace cm
+// vim: ts=4 sw=4 et
@@ -0,0 +1,63 @@
+// Copyright (c) 2021-2022  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/commonmarkcpp
+// contact@m2osw.com
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+#pragma once
+
+/** \file
+ * \brief Declaration of the output_sink class.
+ *
+ * An output sink receives the HTML generated by the commonmark object
+ * as it gets produced, one top-level block at a time, instead of having
+ * the whole document returned in one string.
+ */
+
+
+// C++ lib
+//
+#include    <memory>
+#include    <string>
+
+
+
+namespace cm
+{
+
+
+
+class output_sink
+{
+public:
+    typedef std::shared_ptr<output_sink>
+                            pointer_t;
+
+                            output_sink();
+                            output_sink(output_sink const &) = delete;
+    virtual                 ~output_sink();
+
+    output_sink &           operator = (output_sink const &) = delete;
+
+    void                    write(std::string const & data);
+
+    virtual void            write(char const * data, std::size_t size) = 0;
+    virtual void            finish();
+};
+
+
+
+} // namespace cm
+// vim: ts=4 sw=4 et
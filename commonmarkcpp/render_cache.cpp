@@ -0,0 +1,688 @@
+// Copyright (c) 2021-2022  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/commonmarkcpp
+// contact@m2osw.com
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+/** \file
+ * \brief Implementation of the render_cache class.
+ *
+ * The cache is composed of two files saved in one directory:
+ *
+ * \li `index` -- a header followed by a hash table of entries; the file
+ * is memory mapped by all the processes using the cache;
+ * \li `data` -- the records, each one being a small header followed by
+ * the HTML of one document; new records are appended at the end.
+ *
+ * The processes sharing the cache use flock() on the index file: a shared
+ * lock to search the cache and an exclusive lock to add entries. The last
+ * access time of an entry is updated with atomic operations since many
+ * readers can hold the shared lock at the same time.
+ *
+ * A flock() belongs to the open file, not to a thread, so the threads
+ * using the same render_cache object would share their locks. Each
+ * object also has a mutex held around the flock() so only one of its
+ * threads accesses the files at a time.
+ *
+ * When the data file grows over the maximum size or the hash table is
+ * too full, the cache gets compacted: the least recently used entries
+ * are dropped and the others copied to a new data file which replaces
+ * the old one. The generation number saved in the header tells the other
+ * processes that they need to reopen the data file.
+ */
+
+// self
+//
+#include    "commonmarkcpp/render_cache.h"
+
+#include    "commonmarkcpp/exception.h"
+
+
+// C++ lib
+//
+#include    <algorithm>
+#include    <cerrno>
+#include    <cstring>
+#include    <mutex>
+#include    <vector>
+
+
+// C lib
+//
+#include    <fcntl.h>
+#include    <sys/file.h>
+#include    <sys/mman.h>
+#include    <sys/stat.h>
+#include    <unistd.h>
+
+
+// last include
+//
+#include    <snapdev/poison.h>
+
+
+
+namespace cm
+{
+
+
+
+namespace
+{
+
+
+
+char const              g_magic[8] = { 'C', 'M', 'C', 'A', 'C', 'H', 'E', '1' };
+
+
+struct record_header_t
+{
+    std::uint64_t           f_key = 0;          // the key, to verify the record
+    std::uint32_t           f_size = 0;         // size of the HTML following this header
+    std::uint32_t           f_padding = 0;
+};
+
+
+/** \brief Lock a file for the duration of a block.
+ *
+ * The lock gets released by the destructor, even if an exception occurs.
+ */
+class file_lock
+{
+public:
+    file_lock(int fd, int operation)
+        : f_fd(fd)
+    {
+        while(flock(f_fd, operation) != 0)
+        {
+            if(errno != EINTR)
+            {
+                throw render_cache_error("could not lock the render cache index file.");
+            }
+        }
+    }
+
+    file_lock(file_lock const &) = delete;
+    file_lock & operator = (file_lock const &) = delete;
+
+    ~file_lock()
+    {
+        flock(f_fd, LOCK_UN);
+    }
+
+private:
+    int const       f_fd;
+};
+
+
+bool full_pread(int fd, void * buf, std::size_t size, std::uint64_t offset)
+{
+    char * p(reinterpret_cast<char *>(buf));
+    while(size > 0)
+    {
+        ssize_t const r(pread(fd, p, size, offset));
+        if(r <= 0)
+        {
+            if(r < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+        p += r;
+        size -= r;
+        offset += r;
+    }
+    return true;
+}
+
+
+void full_pwrite(int fd, void const * buf, std::size_t size, std::uint64_t offset)
+{
+    char const * p(reinterpret_cast<char const *>(buf));
+    while(size > 0)
+    {
+        ssize_t const r(pwrite(fd, p, size, offset));
+        if(r < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            throw render_cache_error("could not write to the render cache data file.");
+        }
+        p += r;
+        size -= r;
+        offset += r;
+    }
+}
+
+
+
+}
+// no name namespace
+
+
+
+struct render_cache::header_t
+{
+    char                    f_magic[8] = {};
+    std::uint32_t           f_version = 1;
+    std::uint32_t           f_slots = 0;
+    std::uint64_t           f_generation = 0;
+    std::uint64_t           f_data_size = 0;    // bytes used in the data file
+    std::uint64_t           f_clock = 0;        // incremented on each access
+    std::uint64_t           f_count = 0;        // number of entries
+};
+
+
+struct render_cache::entry_t
+{
+    std::uint64_t           f_key = 0;          // 0 means the slot is empty
+    std::uint64_t           f_offset = 0;       // offset of the record in the data file
+    std::uint64_t           f_access = 0;       // clock of the last access
+    std::uint32_t           f_size = 0;         // size of the HTML
+    std::uint32_t           f_padding = 0;
+};
+
+
+/** \brief Open or create a render cache.
+ *
+ * The cache lives in directory \p path. The directory is created if it
+ * does not exist yet. Many processes can open the same cache at the
+ * same time.
+ *
+ * The \p max_size parameter defines the maximum size of the data file.
+ * Once reached, the least recently used entries get evicted.
+ *
+ * The \p slots parameter is the number of slots in the index. It is only
+ * used when the cache gets created. It gets rounded up to a power of 2.
+ * At most half of the slots are used once the cache was compacted, so
+ * this is about twice the maximum number of documents in the cache.
+ *
+ * \exception render_cache_error
+ * This exception is raised if the cache can't be opened or the index is
+ * not valid.
+ *
+ * \param[in] path  The directory where the cache files are saved.
+ * \param[in] max_size  The maximum size of the data file in bytes.
+ * \param[in] slots  The number of slots of a new index.
+ */
+render_cache::render_cache(
+          std::string const & path
+        , std::size_t max_size
+        , std::size_t slots)
+    : f_path(path)
+    , f_max_size(max_size)
+{
+    if(mkdir(f_path.c_str(), 0755) != 0
+    && errno != EEXIST)
+    {
+        throw render_cache_error("could not create render cache directory \"" + f_path + "\".");
+    }
+
+    std::string const index_filename(f_path + "/index");
+    f_index_fd = open(index_filename.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if(f_index_fd < 0)
+    {
+        throw render_cache_error("could not open render cache index \"" + index_filename + "\".");
+    }
+
+    try
+    {
+        file_lock lock(f_index_fd, LOCK_EX);
+
+        header_t h;
+        struct stat st;
+        if(fstat(f_index_fd, &st) != 0)
+        {
+            throw render_cache_error("could not check the size of the render cache index.");
+        }
+        if(st.st_size == 0)
+        {
+            f_slots = 16;
+            while(f_slots < slots)
+            {
+                f_slots *= 2;
+            }
+            memcpy(h.f_magic, g_magic, sizeof(g_magic));
+            h.f_slots = static_cast<std::uint32_t>(f_slots);
+            f_index_size = sizeof(header_t) + f_slots * sizeof(entry_t);
+            if(ftruncate(f_index_fd, f_index_size) != 0)
+            {
+                throw render_cache_error("could not allocate the render cache index.");
+            }
+            full_pwrite(f_index_fd, &h, sizeof(h), 0);
+
+            // an old data file is not valid with a new index
+            //
+            std::string const data_filename(f_path + "/data");
+            unlink(data_filename.c_str());
+        }
+        else
+        {
+            if(!full_pread(f_index_fd, &h, sizeof(h), 0)
+            || memcmp(h.f_magic, g_magic, sizeof(g_magic)) != 0
+            || h.f_version != 1
+            || h.f_slots < 16
+            || (h.f_slots & (h.f_slots - 1)) != 0)
+            {
+                throw render_cache_error("render cache index \"" + index_filename + "\" is not valid.");
+            }
+            f_slots = h.f_slots;
+            f_index_size = sizeof(header_t) + f_slots * sizeof(entry_t);
+            if(static_cast<std::size_t>(st.st_size) != f_index_size)
+            {
+                throw render_cache_error("render cache index \"" + index_filename + "\" has an invalid size.");
+            }
+        }
+
+        f_index = mmap(nullptr, f_index_size, PROT_READ | PROT_WRITE, MAP_SHARED, f_index_fd, 0);
+        if(f_index == MAP_FAILED)
+        {
+            f_index = nullptr;
+            throw render_cache_error("could not map the render cache index in memory.");
+        }
+
+        open_data();
+    }
+    catch(...)
+    {
+        if(f_index != nullptr)
+        {
+            munmap(f_index, f_index_size);
+        }
+        close(f_index_fd);
+        throw;
+    }
+}
+
+
+/** \brief Close the cache.
+ *
+ * The data is already saved in the files so nothing is lost.
+ */
+render_cache::~render_cache()
+{
+    if(f_data_fd >= 0)
+    {
+        close(f_data_fd);
+    }
+    munmap(f_index, f_index_size);
+    close(f_index_fd);
+}
+
+
+/** \brief The directory of the cache.
+ *
+ * \return The path passed to the constructor.
+ */
+std::string const & render_cache::path() const
+{
+    return f_path;
+}
+
+
+/** \brief The maximum size of the data file.
+ *
+ * \return The maximum size passed to the constructor.
+ */
+std::size_t render_cache::max_size() const
+{
+    return f_max_size;
+}
+
+
+/** \brief Search the cache.
+ *
+ * If the cache has an entry for \p key, the corresponding HTML gets
+ * saved in \p html and the entry is marked as the most recently used.
+ *
+ * \param[in] key  The key of the document, see commonmark::get_cache_key().
+ * \param[out] html  The cached HTML.
+ *
+ * \return true if the HTML was found in the cache.
+ */
+bool render_cache::find(std::uint64_t key, std::string & html)
+{
+    if(key == 0)
+    {
+        key = 1;
+    }
+
+    std::lock_guard<std::mutex> guard(f_mutex);
+    file_lock lock(f_index_fd, LOCK_SH);
+    check_generation();
+
+    entry_t * e(find_entry(key));
+    if(e == nullptr)
+    {
+        return false;
+    }
+
+    record_header_t r;
+    if(!full_pread(f_data_fd, &r, sizeof(r), e->f_offset)
+    || r.f_key != key
+    || r.f_size != e->f_size)
+    {
+        return false;
+    }
+
+    html.resize(r.f_size);
+    if(!full_pread(f_data_fd, &html[0], r.f_size, e->f_offset + sizeof(r)))
+    {
+        html.clear();
+        return false;
+    }
+
+    std::uint64_t const now(__atomic_add_fetch(&header()->f_clock, 1, __ATOMIC_RELAXED));
+    __atomic_store_n(&e->f_access, now, __ATOMIC_RELAXED);
+
+    return true;
+}
+
+
+/** \brief Add a document to the cache.
+ *
+ * This function saves \p html in the cache. If the cache is full, the
+ * least recently used entries get evicted first.
+ *
+ * If another process already saved the same key, nothing happens. A
+ * document larger than the maximum size of the cache is ignored.
+ *
+ * \exception render_cache_error
+ * This exception is raised if the data can't be written to disk.
+ *
+ * \param[in] key  The key of the document, see commonmark::get_cache_key().
+ * \param[in] html  The HTML to save.
+ */
+void render_cache::store(std::uint64_t key, std::string const & html)
+{
+    if(key == 0)
+    {
+        key = 1;
+    }
+
+    std::size_t const record_size(sizeof(record_header_t) + html.length());
+    if(record_size > f_max_size
+    || html.length() > 0xFFFFFFFF)
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> guard(f_mutex);
+    file_lock lock(f_index_fd, LOCK_EX);
+    check_generation();
+
+    if(find_entry(key) != nullptr)
+    {
+        return;
+    }
+
+    header_t * h(header());
+    if(h->f_data_size + record_size > f_max_size
+    || (h->f_count + 1) * 4 > f_slots * 3)
+    {
+        compact(record_size);
+    }
+
+    record_header_t r;
+    r.f_key = key;
+    r.f_size = static_cast<std::uint32_t>(html.length());
+    full_pwrite(f_data_fd, &r, sizeof(r), h->f_data_size);
+    full_pwrite(f_data_fd, html.data(), html.length(), h->f_data_size + sizeof(r));
+
+    entry_t e;
+    e.f_key = key;
+    e.f_offset = h->f_data_size;
+    e.f_size = r.f_size;
+    e.f_access = __atomic_add_fetch(&h->f_clock, 1, __ATOMIC_RELAXED);
+    insert_entry(e);
+
+    h->f_data_size += record_size;
+    ++h->f_count;
+}
+
+
+/** \brief Remove all the entries from the cache.
+ *
+ * This is done for all the processes using this cache.
+ */
+void render_cache::clear()
+{
+    std::lock_guard<std::mutex> guard(f_mutex);
+    file_lock lock(f_index_fd, LOCK_EX);
+    check_generation();
+
+    header_t * h(header());
+    std::fill_n(slots(), f_slots, entry_t());
+    h->f_data_size = 0;
+    h->f_count = 0;
+    if(ftruncate(f_data_fd, 0) != 0)
+    {
+        throw render_cache_error("could not truncate the render cache data file.");
+    }
+}
+
+
+/** \brief Number of documents in the cache.
+ *
+ * \return The number of entries currently in the index.
+ */
+std::size_t render_cache::count()
+{
+    std::lock_guard<std::mutex> guard(f_mutex);
+    file_lock lock(f_index_fd, LOCK_SH);
+    return header()->f_count;
+}
+
+
+/** \brief Number of bytes used in the data file.
+ *
+ * \return The size of the data file in bytes.
+ */
+std::size_t render_cache::data_size()
+{
+    std::lock_guard<std::mutex> guard(f_mutex);
+    file_lock lock(f_index_fd, LOCK_SH);
+    return header()->f_data_size;
+}
+
+
+render_cache::header_t * render_cache::header() const
+{
+    return reinterpret_cast<header_t *>(f_index);
+}
+
+
+render_cache::entry_t * render_cache::slots() const
+{
+    return reinterpret_cast<entry_t *>(reinterpret_cast<char *>(f_index) + sizeof(header_t));
+}
+
+
+/** \brief Open the data file.
+ *
+ * This function (re)opens the data file and saves the generation it
+ * corresponds to. It must be called with the index locked.
+ */
+void render_cache::open_data()
+{
+    if(f_data_fd >= 0)
+    {
+        close(f_data_fd);
+    }
+
+    std::string const data_filename(f_path + "/data");
+    f_data_fd = open(data_filename.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if(f_data_fd < 0)
+    {
+        throw render_cache_error("could not open render cache data \"" + data_filename + "\".");
+    }
+    f_generation = header()->f_generation;
+}
+
+
+/** \brief Reopen the data file if another process compacted the cache.
+ *
+ * This function must be called with the index locked.
+ */
+void render_cache::check_generation()
+{
+    if(header()->f_generation != f_generation)
+    {
+        open_data();
+    }
+}
+
+
+/** \brief Search the index for \p key.
+ *
+ * The index is an open addressing hash table using linear probing. It is
+ * never more than 3/4 full so the search always ends on an empty slot.
+ *
+ * \param[in] key  The key to search.
+ *
+ * \return A pointer to the entry or nullptr if not found.
+ */
+render_cache::entry_t * render_cache::find_entry(std::uint64_t key) const
+{
+    entry_t * const s(slots());
+    std::size_t const mask(f_slots - 1);
+    for(std::size_t idx(key & mask);; idx = (idx + 1) & mask)
+    {
+        if(s[idx].f_key == key)
+        {
+            return s + idx;
+        }
+        if(s[idx].f_key == 0)
+        {
+            return nullptr;
+        }
+    }
+}
+
+
+void render_cache::insert_entry(entry_t const & e)
+{
+    entry_t * const s(slots());
+    std::size_t const mask(f_slots - 1);
+    std::size_t idx(e.f_key & mask);
+    while(s[idx].f_key != 0)
+    {
+        idx = (idx + 1) & mask;
+    }
+    s[idx] = e;
+}
+
+
+/** \brief Evict the least recently used entries.
+ *
+ * The most recently used entries are copied to a new data file until
+ * it reaches 3/4 of the maximum size (including \p needed bytes for the
+ * record about to be added) or half of the slots. The new file then
+ * replaces the old one and the index gets rebuilt.
+ *
+ * This function must be called with the index locked exclusively.
+ *
+ * \param[in] needed  The size of the record to add once done.
+ */
+void render_cache::compact(std::size_t needed)
+{
+    header_t * h(header());
+    entry_t * const s(slots());
+
+    std::vector<entry_t> entries;
+    entries.reserve(h->f_count);
+    for(std::size_t idx(0); idx < f_slots; ++idx)
+    {
+        if(s[idx].f_key != 0)
+        {
+            entries.push_back(s[idx]);
+        }
+    }
+    std::sort(
+          entries.begin()
+        , entries.end()
+        , [](entry_t const & a, entry_t const & b)
+          {
+              return a.f_access > b.f_access;
+          });
+
+    std::string const data_filename(f_path + "/data");
+    std::string const tmp_filename(data_filename + ".tmp");
+    int const fd(open(tmp_filename.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644));
+    if(fd < 0)
+    {
+        throw render_cache_error("could not create render cache data \"" + tmp_filename + "\".");
+    }
+
+    std::size_t const max_size(f_max_size / 4 * 3);
+    std::size_t const max_count(f_slots / 2);
+    std::uint64_t offset(0);
+    std::vector<entry_t> kept;
+    std::string buffer;
+    try
+    {
+        for(auto & e : entries)
+        {
+            std::size_t const record_size(sizeof(record_header_t) + e.f_size);
+            if(offset + record_size + needed > max_size
+            || kept.size() >= max_count)
+            {
+                break;
+            }
+            buffer.resize(record_size);
+            if(!full_pread(f_data_fd, &buffer[0], record_size, e.f_offset))
+            {
+                continue;
+            }
+            full_pwrite(fd, buffer.data(), record_size, offset);
+            e.f_offset = offset;
+            kept.push_back(e);
+            offset += record_size;
+        }
+    }
+    catch(...)
+    {
+        close(fd);
+        unlink(tmp_filename.c_str());
+        throw;
+    }
+    close(fd);
+
+    if(rename(tmp_filename.c_str(), data_filename.c_str()) != 0)
+    {
+        unlink(tmp_filename.c_str());
+        throw render_cache_error("could not replace render cache data \"" + data_filename + "\".");
+    }
+
+    std::fill_n(s, f_slots, entry_t());
+    for(auto const & e : kept)
+    {
+        insert_entry(e);
+    }
+    h->f_data_size = offset;
+    h->f_count = kept.size();
+    ++h->f_generation;
+
+    open_data();
+}
+
+
+
+} // namespace cm
+// vim: ts=4 sw=4 et
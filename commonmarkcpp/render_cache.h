@@ -0,0 +1,104 @@
+// Copyright (c) 2021-2022  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/commonmarkcpp
+// contact@m2osw.com
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+#pragma once
+
+/** \file
+ * \brief Declaration of the render_cache class.
+ *
+ * The render_cache saves the HTML of documents on disk so they do not
+ * need to be rendered again. It is keyed by the commonmark cache key,
+ * a hash of the input and of the settings of the commonmark object.
+ *
+ * One render_cache object can be used by several threads. Its accesses
+ * are serialized by a mutex since the flock() of the index file does
+ * not exclude the threads sharing the same file descriptor.
+ */
+
+
+// C++ lib
+//
+#include    <cstdint>
+#include    <memory>
+#include    <mutex>
+#include    <string>
+
+
+
+namespace cm
+{
+
+
+
+class render_cache
+{
+public:
+    typedef std::shared_ptr<render_cache>
+                            pointer_t;
+
+    static constexpr std::size_t
+                            DEFAULT_MAX_SIZE = 256 * 1024 * 1024;
+    static constexpr std::size_t
+                            DEFAULT_SLOTS = 64 * 1024;
+
+                            render_cache(
+                                  std::string const & path
+                                , std::size_t max_size = DEFAULT_MAX_SIZE
+                                , std::size_t slots = DEFAULT_SLOTS);
+                            render_cache(render_cache const &) = delete;
+                            ~render_cache();
+
+    render_cache &          operator = (render_cache const &) = delete;
+
+    std::string const &     path() const;
+    std::size_t             max_size() const;
+
+    bool                    find(std::uint64_t key, std::string & html);
+    void                    store(std::uint64_t key, std::string const & html);
+    void                    clear();
+
+    std::size_t             count();
+    std::size_t             data_size();
+
+private:
+    struct header_t;
+    struct entry_t;
+
+    header_t *              header() const;
+    entry_t *               slots() const;
+    void                    open_data();
+    void                    check_generation();
+    entry_t *               find_entry(std::uint64_t key) const;
+    void                    insert_entry(entry_t const & e);
+    void                    compact(std::size_t needed);
+
+    std::string const       f_path;
+    std::size_t const       f_max_size;
+    int                     f_index_fd = -1;
+    int                     f_data_fd = -1;
+    void *                  f_index = nullptr;
+    std::size_t             f_index_size = 0;
+    std::size_t             f_slots = 0;
+    std::uint64_t           f_generation = 0;
+    std::mutex              f_mutex = std::mutex();
+};
+
+
+
+} // namespace cm
+// vim: ts=4 sw=4 et
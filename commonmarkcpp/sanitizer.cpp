@@ -0,0 +1,373 @@
+// Copyright (c) 2021-2022  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/commonmarkcpp
+// contact@m2osw.com
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+/** \file
+ * \brief Implementation of the sanitizer class.
+ *
+ * The sanitizer is an allowlist: only the tags, attributes and URL
+ * schemes explicitly allowed are kept in the output. The default
+ * allowlist includes the tags that the Markdown syntax itself generates
+ * and a few common formatting tags, with attributes which can't run
+ * scripts.
+ */
+
+// self
+//
+#include    "commonmarkcpp/sanitizer.h"
+
+#include    "commonmarkcpp/streaming_hash.h"
+
+
+// C++ lib
+//
+#include    <algorithm>
+
+
+// last include
+//
+#include    <snapdev/poison.h>
+
+
+
+namespace cm
+{
+
+
+
+namespace
+{
+
+
+
+char const * const g_default_tags[] =
+{
+    "a",            "href title",
+    "abbr",         "title",
+    "b",            "",
+    "blockquote",   "cite",
+    "br",           "",
+    "code",         "",
+    "dd",           "",
+    "del",          "",
+    "details",      "",
+    "div",          "",
+    "dl",           "",
+    "dt",           "",
+    "em",           "",
+    "h1",           "",
+    "h2",           "",
+    "h3",           "",
+    "h4",           "",
+    "h5",           "",
+    "h6",           "",
+    "hr",           "",
+    "i",            "",
+    "img",          "src alt title width height",
+    "ins",          "",
+    "kbd",          "",
+    "li",           "",
+    "mark",         "",
+    "ol",           "start",
+    "p",            "",
+    "pre",          "",
+    "q",            "cite",
+    "s",            "",
+    "samp",         "",
+    "small",        "",
+    "span",         "",
+    "strong",       "",
+    "sub",          "",
+    "summary",      "",
+    "sup",          "",
+    "table",        "",
+    "tbody",        "",
+    "td",           "align colspan rowspan",
+    "tfoot",        "",
+    "th",           "align colspan rowspan",
+    "thead",        "",
+    "tr",           "",
+    "u",            "",
+    "ul",           "",
+    "var",          "",
+};
+
+
+char const * const g_default_schemes[] =
+{
+    "http",
+    "https",
+    "mailto",
+};
+
+
+char const * const g_url_attributes[] =
+{
+    "action",
+    "background",
+    "cite",
+    "formaction",
+    "href",
+    "longdesc",
+    "poster",
+    "src",
+    "srcset",
+};
+
+
+std::string to_lower(std::string s)
+{
+    std::transform(
+              s.begin()
+            , s.end()
+            , s.begin()
+            , [](char c)
+              {
+                  return c >= 'A' && c <= 'Z' ? c | 0x20 : c;
+              });
+    return s;
+}
+
+
+
+}
+// no name namespace
+
+
+
+/** \brief Initialize the sanitizer with the default allowlist.
+ *
+ * The default allowlist accepts common formatting tags (paragraphs,
+ * emphasis, lists, tables, etc.), links and images with their
+ * URL restricted to the `http`, `https` and `mailto` schemes (and
+ * relative URLs).
+ *
+ * Call clear() to start from an empty allowlist instead.
+ */
+sanitizer::sanitizer()
+{
+    for(std::size_t idx(0); idx < std::size(g_default_tags); idx += 2)
+    {
+        allow_tag(g_default_tags[idx], g_default_tags[idx + 1]);
+    }
+    for(auto const s : g_default_schemes)
+    {
+        allow_scheme(s);
+    }
+}
+
+
+/** \brief Remove all the tags and schemes from the allowlist.
+ *
+ * Once cleared, all raw HTML tags get escaped and only relative URLs
+ * are accepted.
+ */
+void sanitizer::clear()
+{
+    f_tags.clear();
+    f_schemes.clear();
+}
+
+
+/** \brief Allow a tag and some of its attributes.
+ *
+ * The \p attributes parameter is a list of attribute names separated by
+ * spaces. Other attributes are removed from the tag. Calling this function
+ * again for the same tag adds more attributes.
+ *
+ * Names are case insensitive.
+ *
+ * \param[in] tag  The name of the tag to allow.
+ * \param[in] attributes  The attributes allowed in that tag.
+ */
+void sanitizer::allow_tag(std::string const & tag, std::string const & attributes)
+{
+    std::set<std::string> & names(f_tags[to_lower(tag)]);
+    std::string::size_type pos(0);
+    while(pos < attributes.length())
+    {
+        std::string::size_type end(attributes.find(' ', pos));
+        if(end == std::string::npos)
+        {
+            end = attributes.length();
+        }
+        if(end > pos)
+        {
+            names.insert(to_lower(attributes.substr(pos, end - pos)));
+        }
+        pos = end + 1;
+    }
+}
+
+
+/** \brief Allow a URL scheme.
+ *
+ * URLs found in attributes such as `href` and `src` and in Markdown links
+ * and images must use one of the allowed schemes or be relative.
+ *
+ * \param[in] scheme  The scheme to allow, without the colon (i.e. "https").
+ */
+void sanitizer::allow_scheme(std::string const & scheme)
+{
+    f_schemes.insert(to_lower(scheme));
+}
+
+
+/** \brief Check whether a tag is allowed.
+ *
+ * \param[in] tag  The lowercase name of the tag.
+ *
+ * \return true if the tag is part of the allowlist.
+ */
+bool sanitizer::is_tag_allowed(std::string const & tag) const
+{
+    return f_tags.find(tag) != f_tags.end();
+}
+
+
+/** \brief Check whether an attribute is allowed in a tag.
+ *
+ * \param[in] tag  The lowercase name of the tag.
+ * \param[in] attribute  The lowercase name of the attribute.
+ *
+ * \return true if the attribute is allowed in that tag.
+ */
+bool sanitizer::is_attribute_allowed(std::string const & tag, std::string const & attribute) const
+{
+    auto const it(f_tags.find(tag));
+    if(it == f_tags.end())
+    {
+        return false;
+    }
+    return it->second.find(attribute) != it->second.end();
+}
+
+
+/** \brief Check whether a URL uses an allowed scheme.
+ *
+ * Relative URLs (no colon before the first `/`, `?` or `#`) are always
+ * allowed. Otherwise the scheme must be part of the allowlist.
+ *
+ * A URL with an entity, a blank or a control character before its first
+ * `/`, `?` or `#` is not allowed since browsers decode or remove those
+ * (a common way to hide `javascript:` from filters).
+ *
+ * \param[in] url  The URL to check.
+ *
+ * \return true if the URL can be output.
+ */
+bool sanitizer::is_url_allowed(std::string const & url) const
+{
+    std::string scheme;
+    for(auto const c : url)
+    {
+        switch(c)
+        {
+        case ':':
+            return f_schemes.find(scheme) != f_schemes.end();
+
+        case '/':
+        case '?':
+        case '#':
+            return true;
+
+        default:
+            if((c >= 'a' && c <= 'z')
+            || (c >= '0' && c <= '9')
+            || c == '+'
+            || c == '-'
+            || c == '.')
+            {
+                scheme += c;
+            }
+            else if(c >= 'A' && c <= 'Z')
+            {
+                scheme += static_cast<char>(c | 0x20);
+            }
+            else if(c == '&'
+                 || static_cast<unsigned char>(c) <= 0x20
+                 || c == 0x7F)
+            {
+                // browsers ignore blanks and controls and decode entities
+                // so these could hide a scheme such as "javascript:"
+                //
+                return false;
+            }
+            else
+            {
+                // not a valid scheme, so this is a relative URL
+                //
+                return true;
+            }
+            break;
+
+        }
+    }
+
+    return true;
+}
+
+
+/** \brief Compute a fingerprint of the allowlist.
+ *
+ * Two sanitizers with the same tags, attributes and schemes have the
+ * same fingerprint.
+ *
+ * \return A 64 bit hash of the allowlist.
+ */
+std::uint64_t sanitizer::fingerprint() const
+{
+    streaming_hash h;
+    for(auto const & t : f_tags)
+    {
+        h.add(t.first.c_str(), t.first.length() + 1);
+        for(auto const & a : t.second)
+        {
+            h.add(" ", 1);
+            h.add(a.c_str(), a.length() + 1);
+        }
+    }
+    h.add("\n", 1);
+    for(auto const & s : f_schemes)
+    {
+        h.add(s.c_str(), s.length() + 1);
+    }
+    return h.digest();
+}
+
+
+/** \brief Check whether an attribute holds a URL.
+ *
+ * The values of these attributes are checked with is_url_allowed().
+ *
+ * \param[in] attribute  The lowercase name of the attribute.
+ *
+ * \return true if the attribute is expected to hold a URL.
+ */
+bool sanitizer::is_url_attribute(std::string const & attribute)
+{
+    return std::find(
+              std::begin(g_url_attributes)
+            , std::end(g_url_attributes)
+            , attribute) != std::end(g_url_attributes);
+}
+
+
+
+} // namespace cm
+// vim: ts=4 sw=4 et
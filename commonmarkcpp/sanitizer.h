@@ -0,0 +1,74 @@
+// Copyright (c) 2021-2022  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/commonmarkcpp
+// contact@m2osw.com
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+#pragma once
+
+/** \file
+ * \brief Declaration of the sanitizer class.
+ *
+ * The sanitizer holds the allowlist of HTML tags, attributes and URL
+ * schemes accepted in raw HTML when processing untrusted content. The
+ * commonmark object uses it to filter the HTML as it gets generated.
+ */
+
+
+// C++ lib
+//
+#include    <cstdint>
+#include    <map>
+#include    <memory>
+#include    <set>
+#include    <string>
+
+
+
+namespace cm
+{
+
+
+
+class sanitizer
+{
+public:
+    typedef std::shared_ptr<sanitizer>
+                            pointer_t;
+
+                            sanitizer();
+
+    void                    clear();
+    void                    allow_tag(std::string const & tag, std::string const & attributes = std::string());
+    void                    allow_scheme(std::string const & scheme);
+
+    bool                    is_tag_allowed(std::string const & tag) const;
+    bool                    is_attribute_allowed(std::string const & tag, std::string const & attribute) const;
+    bool                    is_url_allowed(std::string const & url) const;
+
+    std::uint64_t           fingerprint() const;
+
+    static bool             is_url_attribute(std::string const & attribute);
+
+private:
+    std::map<std::string, std::set<std::string>>
+                            f_tags = std::map<std::string, std::set<std::string>>();
+    std::set<std::string>   f_schemes = std::set<std::string>();
+};
+
+
+
+} // namespace cm
+// vim: ts=4 sw=4 et
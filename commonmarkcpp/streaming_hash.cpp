@@ -0,0 +1,299 @@
+// Copyright (c) 2021-2022  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/commonmarkcpp
+// contact@m2osw.com
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+/** \file
+ * \brief Implementation of the streaming_hash class.
+ *
+ * The hash implemented here is the 64 bit xxHash algorithm (XXH64). It
+ * is very fast, has good dispersion, and the result does not depend on
+ * how the input gets split in chunks, which is what we need to hash
+ * output as it gets generated.
+ *
+ * The input is viewed as little endian 64 bit words whatever the
+ * processor, so the resulting hashes are the same on all platforms.
+ */
+
+// self
+//
+#include    "commonmarkcpp/streaming_hash.h"
+
+
+// snapdev
+//
+#include    <snapdev/hexadecimal_string.h>
+
+
+// C++ lib
+//
+#include    <cstring>
+
+
+// last include
+//
+#include    <snapdev/poison.h>
+
+
+
+namespace cm
+{
+
+
+
+namespace
+{
+
+
+
+constexpr std::uint64_t     g_prime1 = 0x9E3779B185EBCA87ULL;
+constexpr std::uint64_t     g_prime2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr std::uint64_t     g_prime3 = 0x165667B19E3779F9ULL;
+constexpr std::uint64_t     g_prime4 = 0x85EBCA77C2B2AE63ULL;
+constexpr std::uint64_t     g_prime5 = 0x27D4EB2F165667C5ULL;
+
+
+inline std::uint64_t rotate_left(std::uint64_t value, int bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+
+inline std::uint64_t read64(std::uint8_t const * p)
+{
+    return static_cast<std::uint64_t>(p[0])
+         | (static_cast<std::uint64_t>(p[1]) << 8)
+         | (static_cast<std::uint64_t>(p[2]) << 16)
+         | (static_cast<std::uint64_t>(p[3]) << 24)
+         | (static_cast<std::uint64_t>(p[4]) << 32)
+         | (static_cast<std::uint64_t>(p[5]) << 40)
+         | (static_cast<std::uint64_t>(p[6]) << 48)
+         | (static_cast<std::uint64_t>(p[7]) << 56);
+}
+
+
+inline std::uint32_t read32(std::uint8_t const * p)
+{
+    return static_cast<std::uint32_t>(p[0])
+         | (static_cast<std::uint32_t>(p[1]) << 8)
+         | (static_cast<std::uint32_t>(p[2]) << 16)
+         | (static_cast<std::uint32_t>(p[3]) << 24);
+}
+
+
+inline std::uint64_t hash_round(std::uint64_t accumulator, std::uint64_t input)
+{
+    accumulator += input * g_prime2;
+    accumulator = rotate_left(accumulator, 31);
+    return accumulator * g_prime1;
+}
+
+
+inline std::uint64_t merge_round(std::uint64_t h, std::uint64_t accumulator)
+{
+    h ^= hash_round(0, accumulator);
+    return h * g_prime1 + g_prime4;
+}
+
+
+
+}
+// no name namespace
+
+
+
+/** \brief Initialize the hash.
+ *
+ * The hash is ready to receive data. The \p seed can be used to compute
+ * different hashes of the same data.
+ *
+ * \param[in] seed  The seed of this hash.
+ */
+streaming_hash::streaming_hash(std::uint64_t seed)
+{
+    reset(seed);
+}
+
+
+/** \brief Restart the hash from scratch.
+ *
+ * This function forgets about all the data added so far.
+ *
+ * \param[in] seed  The seed of this hash.
+ */
+void streaming_hash::reset(std::uint64_t seed)
+{
+    f_seed = seed;
+    f_accumulators[0] = seed + g_prime1 + g_prime2;
+    f_accumulators[1] = seed + g_prime2;
+    f_accumulators[2] = seed;
+    f_accumulators[3] = seed - g_prime1;
+    f_total_size = 0;
+    f_buffer_size = 0;
+}
+
+
+/** \brief Add data to the hash.
+ *
+ * The data is processed in stripes of 32 bytes. Bytes which do not fill
+ * a complete stripe are kept in a buffer until more data is added or
+ * the digest() gets computed.
+ *
+ * \param[in] data  The data to add to the hash.
+ * \param[in] size  The number of bytes in \p data.
+ */
+void streaming_hash::add(void const * data, std::size_t size)
+{
+    std::uint8_t const * p(reinterpret_cast<std::uint8_t const *>(data));
+    std::uint8_t const * const end(p + size);
+    f_total_size += size;
+
+    if(f_buffer_size + size < sizeof(f_buffer))
+    {
+        if(size > 0)
+        {
+            memcpy(f_buffer + f_buffer_size, p, size);
+            f_buffer_size += static_cast<std::uint32_t>(size);
+        }
+        return;
+    }
+
+    if(f_buffer_size > 0)
+    {
+        std::size_t const missing(sizeof(f_buffer) - f_buffer_size);
+        memcpy(f_buffer + f_buffer_size, p, missing);
+        p += missing;
+        f_accumulators[0] = hash_round(f_accumulators[0], read64(f_buffer +  0));
+        f_accumulators[1] = hash_round(f_accumulators[1], read64(f_buffer +  8));
+        f_accumulators[2] = hash_round(f_accumulators[2], read64(f_buffer + 16));
+        f_accumulators[3] = hash_round(f_accumulators[3], read64(f_buffer + 24));
+        f_buffer_size = 0;
+    }
+
+    for(; p + sizeof(f_buffer) <= end; p += sizeof(f_buffer))
+    {
+        f_accumulators[0] = hash_round(f_accumulators[0], read64(p +  0));
+        f_accumulators[1] = hash_round(f_accumulators[1], read64(p +  8));
+        f_accumulators[2] = hash_round(f_accumulators[2], read64(p + 16));
+        f_accumulators[3] = hash_round(f_accumulators[3], read64(p + 24));
+    }
+
+    if(p < end)
+    {
+        f_buffer_size = static_cast<std::uint32_t>(end - p);
+        memcpy(f_buffer, p, f_buffer_size);
+    }
+}
+
+
+void streaming_hash::add(std::string const & data)
+{
+    add(data.data(), data.length());
+}
+
+
+/** \brief Compute the hash of the data added so far.
+ *
+ * This function does not modify the state of the hash so you can
+ * continue to add data and call digest() again later.
+ *
+ * \return The 64 bit hash of all the data added so far.
+ */
+std::uint64_t streaming_hash::digest() const
+{
+    std::uint64_t h(0);
+    if(f_total_size >= sizeof(f_buffer))
+    {
+        h = rotate_left(f_accumulators[0], 1)
+          + rotate_left(f_accumulators[1], 7)
+          + rotate_left(f_accumulators[2], 12)
+          + rotate_left(f_accumulators[3], 18);
+        h = merge_round(h, f_accumulators[0]);
+        h = merge_round(h, f_accumulators[1]);
+        h = merge_round(h, f_accumulators[2]);
+        h = merge_round(h, f_accumulators[3]);
+    }
+    else
+    {
+        h = f_seed + g_prime5;
+    }
+
+    h += f_total_size;
+
+    std::uint8_t const * p(f_buffer);
+    std::uint8_t const * const end(f_buffer + f_buffer_size);
+    for(; p + 8 <= end; p += 8)
+    {
+        h ^= hash_round(0, read64(p));
+        h = rotate_left(h, 27) * g_prime1 + g_prime4;
+    }
+    if(p + 4 <= end)
+    {
+        h ^= static_cast<std::uint64_t>(read32(p)) * g_prime1;
+        h = rotate_left(h, 23) * g_prime2 + g_prime3;
+        p += 4;
+    }
+    for(; p < end; ++p)
+    {
+        h ^= *p * g_prime5;
+        h = rotate_left(h, 11) * g_prime1;
+    }
+
+    h ^= h >> 33;
+    h *= g_prime2;
+    h ^= h >> 29;
+    h *= g_prime3;
+    h ^= h >> 32;
+
+    return h;
+}
+
+
+/** \brief Hash a buffer in one go.
+ *
+ * \param[in] data  The data to hash.
+ * \param[in] size  The number of bytes in \p data.
+ * \param[in] seed  The seed of the hash.
+ *
+ * \return The 64 bit hash of \p data.
+ */
+std::uint64_t streaming_hash::hash(void const * data, std::size_t size, std::uint64_t seed)
+{
+    streaming_hash h(seed);
+    h.add(data, size);
+    return h.digest();
+}
+
+
+/** \brief Convert a hash to a string.
+ *
+ * The hash is converted to 16 hexadecimal digits.
+ *
+ * \param[in] h  The hash to convert.
+ *
+ * \return The hash as a string.
+ */
+std::string streaming_hash::to_string(std::uint64_t h)
+{
+    std::string result(snapdev::int_to_hex(h, false, 16));
+    return result;
+}
+
+
+
+} // namespace cm
+// vim: ts=4 sw=4 et
@@ -0,0 +1,65 @@
+// Copyright (c) 2021-2022  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/commonmarkcpp
+// contact@m2osw.com
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+#pragma once
+
+/** \file
+ * \brief Declaration of the streaming_hash class.
+ *
+ * The streaming_hash computes a fast, non-cryptographic, 64 bit hash
+ * of data which can be added in chunks of any size.
+ */
+
+
+// C++ lib
+//
+#include    <cstdint>
+#include    <string>
+
+
+
+namespace cm
+{
+
+
+
+class streaming_hash
+{
+public:
+                            streaming_hash(std::uint64_t seed = 0);
+
+    void                    reset(std::uint64_t seed = 0);
+    void                    add(void const * data, std::size_t size);
+    void                    add(std::string const & data);
+    std::uint64_t           digest() const;
+
+    static std::uint64_t    hash(void const * data, std::size_t size, std::uint64_t seed = 0);
+    static std::string      to_string(std::uint64_t h);
+
+private:
+    std::uint64_t           f_accumulators[4] = {};
+    std::uint64_t           f_seed = 0;
+    std::uint64_t           f_total_size = 0;
+    std::uint8_t            f_buffer[32] = {};
+    std::uint32_t           f_buffer_size = 0;
+};
+
+
+
+} // namespace cm
+// vim: ts=4 sw=4 et
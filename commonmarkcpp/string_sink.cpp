@@ -0,0 +1,77 @@
+// Copyright (c) 2021-2022  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/commonmarkcpp
+// contact@m2osw.com
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+/** \file
+ * \brief Implementation of the string_sink class.
+ *
+ * The string_sink saves the output in memory. It is mainly useful as the
+ * last sink of a chain of sinks, i.e. to retrieve the compressed output
+ * of a deflate_sink.
+ */
+
+// self
+//
+#include    "commonmarkcpp/string_sink.h"
+
+
+// last include
+//
+#include    <snapdev/poison.h>
+
+
+
+namespace cm
+{
+
+
+
+/** \brief Append data to the string.
+ *
+ * \param[in] data  The data to append.
+ * \param[in] size  The number of bytes in \p data.
+ */
+void string_sink::write(char const * data, std::size_t size)
+{
+    f_data.append(data, size);
+}
+
+
+/** \brief Retrieve the data written so far.
+ *
+ * \return A reference to the string holding the data.
+ */
+std::string const & string_sink::str() const
+{
+    return f_data;
+}
+
+
+/** \brief Forget about the data written so far.
+ *
+ * This function clears the string so the sink can be reused.
+ */
+void string_sink::clear()
+{
+    f_data.clear();
+}
+
+
+
+} // namespace cm
+// vim: ts=4 sw=4 et
@@ -0,0 +1,60 @@
+// Copyright (c) 2021-2022  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/commonmarkcpp
+// contact@m2osw.com
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+#pragma once
+
+/** \file
+ * \brief Declaration of the string_sink class.
+ *
+ * The string_sink is the simplest of the output sinks: it appends the
+ * data it receives to a string.
+ */
+
+
+// self
+//
+#include    "commonmarkcpp/output_sink.h"
+
+
+
+namespace cm
+{
+
+
+
+class string_sink
+    : public output_sink
+{
+public:
+    typedef std::shared_ptr<string_sink>
+                            pointer_t;
+
+    virtual void            write(char const * data, std::size_t size) override;
+    using output_sink::write;
+
+    std::string const &     str() const;
+    void                    clear();
+
+private:
+    std::string             f_data = std::string();
+};
+
+
+
+} // namespace cm
+// vim: ts=4 sw=4 et
@@ -0,0 +1,285 @@
+// Copyright (c) 2021-2022  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/commonmarkcpp
+// contact@m2osw.com
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+/** \file
+ * \brief Implementation of the utf8_input class.
+ *
+ * The input is validated in one pass before the parser starts. Blocks
+ * of 32 bytes of ASCII are checked with a few 64 bit operations; the
+ * other bytes get checked one sequence at a time. Invalid sequences are
+ * replaced by the replacement character (U+FFFD) so the parser never
+ * has to deal with them.
+ */
+
+// self
+//
+#include    "commonmarkcpp/utf8_input.h"
+
+
+// C++ lib
+//
+#include    <cstring>
+
+
+// last include
+//
+#include    <snapdev/poison.h>
+
+
+
+namespace cm
+{
+
+
+
+namespace
+{
+
+
+
+constexpr std::uint64_t     g_high_bits = 0x8080808080808080ULL;
+
+constexpr std::size_t       g_block_size = 32;
+
+constexpr char const        g_replacement_character[] = "\xEF\xBF\xBD";
+
+
+/** \brief Check one UTF-8 sequence.
+ *
+ * This function checks the sequence starting at \p s. Overlong sequences,
+ * surrogates, and characters over U+10FFFF are considered invalid.
+ *
+ * When the sequence is invalid, the function returns the length of its
+ * maximal subpart as a negative number. That subpart gets replaced by
+ * one replacement character, as recommended by the Unicode standard.
+ *
+ * \param[in] s  The start of the sequence.
+ * \param[in] end  The end of the input.
+ *
+ * \return The length of the sequence, or minus the number of bytes to
+ * replace if the sequence is invalid.
+ */
+int sequence_length(unsigned char const * s, unsigned char const * end)
+{
+    unsigned char const c(s[0]);
+    if(c < 0x80)
+    {
+        return 1;
+    }
+
+    int length(0);
+    unsigned char low(0x80);
+    unsigned char high(0xBF);
+    if(c >= 0xC2 && c <= 0xDF)
+    {
+        length = 2;
+    }
+    else if(c >= 0xE0 && c <= 0xEF)
+    {
+        length = 3;
+        if(c == 0xE0)
+        {
+            low = 0xA0;     // overlong
+        }
+        else if(c == 0xED)
+        {
+            high = 0x9F;    // surrogates
+        }
+    }
+    else if(c >= 0xF0 && c <= 0xF4)
+    {
+        length = 4;
+        if(c == 0xF0)
+        {
+            low = 0x90;     // overlong
+        }
+        else if(c == 0xF4)
+        {
+            high = 0x8F;    // over U+10FFFF
+        }
+    }
+    else
+    {
+        return -1;
+    }
+
+    for(int idx(1); idx < length; ++idx)
+    {
+        if(s + idx >= end
+        || s[idx] < low
+        || s[idx] > high)
+        {
+            return -idx;
+        }
+        low = 0x80;
+        high = 0xBF;
+    }
+
+    return length;
+}
+
+
+
+}
+// no name namespace
+
+
+
+/** \brief Start reading a new input.
+ *
+ * The function validates the entire \p input. If it is valid, the
+ * characters are decoded directly from \p input, which therefore needs
+ * to remain unchanged until you are done reading. Otherwise a fixed copy
+ * is made and the characters are decoded from that copy.
+ *
+ * The position is reset to the start of the input.
+ *
+ * \param[in] input  The UTF-8 input to read.
+ */
+void utf8_input::reset(std::string const & input)
+{
+    f_position = 0;
+    if(valid_length(input) == input.length())
+    {
+        f_fixed.clear();
+        f_data = input.data();
+        f_size = input.length();
+    }
+    else
+    {
+        f_fixed = fix(input);
+        f_data = f_fixed.data();
+        f_size = f_fixed.length();
+    }
+}
+
+
+/** \brief Get the current position in the input.
+ *
+ * \return The byte offset of the next character to be read.
+ */
+std::string::size_type utf8_input::position() const
+{
+    return f_position;
+}
+
+
+/** \brief Go back to a position returned by position().
+ *
+ * \param[in] position  The position to restore.
+ */
+void utf8_input::set_position(std::string::size_type position)
+{
+    f_position = position;
+}
+
+
+/** \brief Search for the first invalid UTF-8 sequence.
+ *
+ * The function checks the bytes starting at \p start. As long as blocks
+ * of 32 bytes are all ASCII, they are checked with a few 64 bit
+ * operations. When a block includes other bytes, each sequence gets
+ * checked separately until the end of that block.
+ *
+ * \param[in] input  The string to check.
+ * \param[in] start  The offset where the check starts.
+ *
+ * \return The offset of the first invalid sequence or input.length()
+ * if the input is valid.
+ */
+std::string::size_type utf8_input::valid_length(std::string const & input, std::string::size_type start)
+{
+    unsigned char const * const begin(reinterpret_cast<unsigned char const *>(input.data()));
+    unsigned char const * const end(begin + input.length());
+    unsigned char const * s(begin + start);
+    while(s < end)
+    {
+        // ASCII fast path
+        //
+        while(static_cast<std::size_t>(end - s) >= g_block_size)
+        {
+            std::uint64_t words[g_block_size / sizeof(std::uint64_t)];
+            memcpy(words, s, sizeof(words));
+            if(((words[0] | words[1] | words[2] | words[3]) & g_high_bits) != 0)
+            {
+                break;
+            }
+            s += g_block_size;
+        }
+
+        unsigned char const * const block_end(
+                static_cast<std::size_t>(end - s) >= g_block_size
+                    ? s + g_block_size
+                    : end);
+        while(s < block_end)
+        {
+            if(*s < 0x80)
+            {
+                ++s;
+                continue;
+            }
+            int const length(sequence_length(s, end));
+            if(length < 0)
+            {
+                return s - begin;
+            }
+            s += length;
+        }
+    }
+
+    return input.length();
+}
+
+
+/** \brief Replace the invalid sequences of \p input.
+ *
+ * Each invalid sequence found in \p input gets replaced by one
+ * replacement character (U+FFFD). The valid parts are copied as is.
+ *
+ * \param[in] input  The string to fix.
+ *
+ * \return A valid UTF-8 string.
+ */
+std::string utf8_input::fix(std::string const & input)
+{
+    unsigned char const * const begin(reinterpret_cast<unsigned char const *>(input.data()));
+    unsigned char const * const end(begin + input.length());
+
+    std::string result;
+    result.reserve(input.length() + sizeof(g_replacement_character));
+
+    std::string::size_type start(0);
+    for(;;)
+    {
+        std::string::size_type const valid(valid_length(input, start));
+        result.append(input, start, valid - start);
+        if(valid >= input.length())
+        {
+            return result;
+        }
+
+        result += g_replacement_character;
+        start = valid - sequence_length(begin + valid, end);
+    }
+}
+
+
+
+} // namespace cm
+// vim: ts=4 sw=4 et
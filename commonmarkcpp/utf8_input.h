@@ -0,0 +1,132 @@
+// Copyright (c) 2021-2022  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/commonmarkcpp
+// contact@m2osw.com
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+#pragma once
+
+/** \file
+ * \brief Declaration of the utf8_input class.
+ *
+ * The utf8_input validates the whole input before the parser reads it
+ * and then decodes it one character at a time without having to check
+ * for errors.
+ */
+
+
+// libutf8 lib
+//
+#include    <libutf8/libutf8.h>
+
+
+// C++ lib
+//
+#include    <cstdint>
+#include    <string>
+
+
+
+namespace cm
+{
+
+
+
+class utf8_input
+{
+public:
+    void                    reset(std::string const & input);
+
+    std::string::size_type  position() const;
+    void                    set_position(std::string::size_type position);
+
+    /** \brief Read the next character.
+     *
+     * The input was validated by reset() so the decoding does not need
+     * to check for invalid sequences.
+     *
+     * \return The next character or libutf8::EOS at the end of the input.
+     */
+    char32_t get()
+    {
+        if(f_position >= f_size)
+        {
+            return libutf8::EOS;
+        }
+
+        unsigned char const * s(reinterpret_cast<unsigned char const *>(f_data) + f_position);
+        char32_t const c(s[0]);
+        if(c < 0x80)
+        {
+            ++f_position;
+            return c;
+        }
+        if(c < 0xE0)
+        {
+            f_position += 2;
+            return ((c & 0x1F) << 6)
+                  | (s[1] & 0x3F);
+        }
+        if(c < 0xF0)
+        {
+            f_position += 3;
+            return ((c & 0x0F) << 12)
+                  | ((s[1] & 0x3F) << 6)
+                  | (s[2] & 0x3F);
+        }
+        f_position += 4;
+        return ((c & 0x07) << 18)
+              | ((s[1] & 0x3F) << 12)
+              | ((s[2] & 0x3F) << 6)
+              | (s[3] & 0x3F);
+    }
+
+    /** \brief Check the next byte without reading it.
+     *
+     * \return The next byte or -1 at the end of the input.
+     */
+    int peek_byte() const
+    {
+        if(f_position >= f_size)
+        {
+            return -1;
+        }
+        return static_cast<unsigned char>(f_data[f_position]);
+    }
+
+    /** \brief Skip one byte.
+     *
+     * This is used after a peek_byte() returned an ASCII character.
+     */
+    void skip_byte()
+    {
+        ++f_position;
+    }
+
+    static std::string::size_type
+                            valid_length(std::string const & input, std::string::size_type start = 0);
+    static std::string      fix(std::string const & input);
+
+private:
+    char const *            f_data = nullptr;
+    std::string::size_type  f_size = 0;
+    std::string::size_type  f_position = 0;
+    std::string             f_fixed = std::string();
+};
+
+
+
+} // namespace cm
+// vim: ts=4 sw=4 et
@@ -25,6 +25,10 @@
 // commonmarkcpp lib
 //
 #include    <commonmarkcpp/commonmark.h>
+#include    <commonmarkcpp/block.h>
+#include    <commonmarkcpp/block_extension.h>
+#include    <commonmarkcpp/inline_extension.h>
+#include    <commonmarkcpp/streaming_hash.h>
 
 
 // libutf8 lib
@@ -37,6 +41,13 @@
 #include    <snapdev/file_contents.h>
 
 
+// C++ lib
+//
+#include    <chrono>
+#include    <fstream>
+#include    <iostream>
+
+
 // C lib
 //
 //#include    <unistd.h>
@@ -198,6 +209,1214 @@ CATCH_TEST_CASE("commonmark_atx_heading", "[direct-test][block]")
 }
 
 
+CATCH_TEST_CASE("commonmark_block_index", "[direct-test][block]")
+{
+    CATCH_START_SECTION("cm: render each block from the block index")
+    {
+        std::string const input(
+                "# Title\n"
+                "\n"
+                "First [paragraph][ref].\n"
+                "\n"
+                "* one\n"
+                "* two\n"
+                "\n"
+                "Second\n"
+                "===\n"
+                "\n"
+                "[ref]: /url \"T\"\n"
+                "\n"
+                "---\n");
+
+        cm::commonmark md;
+        md.set_build_block_index();
+        std::string const html(md.process(input));
+
+        cm::block_index const & index(md.get_block_index());
+        CATCH_REQUIRE(index.size() == 5);
+        CATCH_REQUIRE(index.input_size() == input.length());
+        CATCH_REQUIRE(index.entry(0).f_offset == 0);
+        CATCH_REQUIRE(index.entry(1).f_line == 3);
+        CATCH_REQUIRE(index.entry(3).f_line == 8);
+        CATCH_REQUIRE(index.references().size() == 1);
+
+        // save & reload the index, then render one block at a time
+        //
+        cm::block_index reloaded;
+        CATCH_REQUIRE(reloaded.unserialize(index.serialize()));
+        CATCH_REQUIRE(reloaded.size() == index.size());
+
+        std::string blocks;
+        for(std::size_t idx(0); idx < reloaded.size(); ++idx)
+        {
+            cm::commonmark page;
+            blocks += page.process_blocks(input, reloaded, idx, 1);
+        }
+        CATCH_REQUIRE(blocks == html);
+
+        cm::commonmark range;
+        CATCH_REQUIRE(range.process_blocks(input, reloaded, 1, 1)
+                == "<p>First <a href=\"/url\" title=\"T\">paragraph</a>.</p>\n");
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("cm: block index references are limited to process_blocks()")
+    {
+        std::string const input(
+                "[ref] and [user]\n"
+                "\n"
+                "[ref]: /url\n");
+
+        cm::features f;
+        f.set_commonmark_compatible();
+        cm::commonmark md;
+        md.set_features(f);
+        md.set_build_block_index();
+        md.add_link("user", "/user", "", true);
+        md.process(input);
+        cm::block_index const index(md.get_block_index());
+
+        cm::commonmark page;
+        page.set_features(f);
+        page.add_link("user", "/user", "", true);
+        CATCH_REQUIRE(page.process_blocks(input, index, 0, 1)
+                == "<p><a href=\"/url\">ref</a> and <a href=\"/user\">user</a></p>\n");
+        CATCH_REQUIRE(page.find_link_reference("ref") == nullptr);
+        CATCH_REQUIRE(page.find_link_reference("user") != nullptr);
+        CATCH_REQUIRE(page.process("[ref] and [user]\n")
+                == "<p>[ref] and <a href=\"/user\">user</a></p>\n");
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("cm: invalid block index")
+    {
+        cm::block_index index;
+        CATCH_REQUIRE_FALSE(index.unserialize("CMBX"));
+        CATCH_REQUIRE_FALSE(index.unserialize(std::string("CMBI\x01\0\0\0", 8)));
+        CATCH_REQUIRE(index.size() == 0);
+
+        cm::commonmark md;
+        CATCH_REQUIRE_THROWS_AS(md.process_blocks("# Title", index, 0, 1), cm::commonmark_out_of_range);
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("commonmark_block_hashes", "[direct-test][block]")
+{
+    CATCH_START_SECTION("cm: one hash per top-level block")
+    {
+        std::string const input(
+                "# Title\n"
+                "\n"
+                "Some text.\n"
+                "\n"
+                "* one\n"
+                "* two\n");
+
+        cm::commonmark md;
+        md.set_compute_block_hashes();
+        std::string const html(md.process(input));
+
+        cm::commonmark::block_hash_t::vector_t const hashes(md.get_block_hashes());
+        CATCH_REQUIRE(hashes.size() == 3);
+        std::size_t offset(0);
+        for(auto const & h : hashes)
+        {
+            CATCH_REQUIRE(h.f_offset == offset);
+            CATCH_REQUIRE(h.f_hash == cm::streaming_hash::hash(html.data() + h.f_offset, h.f_size));
+            offset += h.f_size;
+        }
+        CATCH_REQUIRE(offset == html.length());
+        CATCH_REQUIRE(html.substr(hashes[1].f_offset, hashes[1].f_size) == "<p>Some text.</p>\n");
+
+        // editing one block only changes the hash of that block
+        //
+        cm::commonmark edited;
+        edited.set_compute_block_hashes();
+        edited.process(
+                "# Title\n"
+                "\n"
+                "Other text.\n"
+                "\n"
+                "* one\n"
+                "* two\n");
+        cm::commonmark::block_hash_t::vector_t const edited_hashes(edited.get_block_hashes());
+        CATCH_REQUIRE(edited_hashes.size() == 3);
+        CATCH_REQUIRE(edited_hashes[0].f_hash == hashes[0].f_hash);
+        CATCH_REQUIRE(edited_hashes[1].f_hash != hashes[1].f_hash);
+        CATCH_REQUIRE(edited_hashes[2].f_hash == hashes[2].f_hash);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("cm: no hashes by default")
+    {
+        cm::commonmark md;
+        md.process("Some text.\n");
+        CATCH_REQUIRE(md.get_block_hashes().empty());
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("commonmark_output_hash", "[direct-test][block]")
+{
+    CATCH_START_SECTION("cm: output hash computed while generating")
+    {
+        std::string const input(
+                "# Title\n"
+                "\n"
+                "Some *text*.\n"
+                "\n"
+                "* one\n"
+                "* two\n");
+
+        cm::features f;
+        f.set_add_document_div(true);
+        cm::commonmark md;
+        md.set_features(f);
+        md.set_compute_output_hash();
+        std::string const html(md.process(input));
+        CATCH_REQUIRE(md.get_output_hash() == cm::streaming_hash::hash(html.data(), html.length()));
+
+        // the same hash in stream mode
+        //
+        md.start();
+        std::string streamed(md.add_input(input.substr(0, 10)));
+        streamed += md.add_input(input.substr(10));
+        streamed += md.finish();
+        CATCH_REQUIRE(streamed == html);
+        CATCH_REQUIRE(md.get_output_hash() == cm::streaming_hash::hash(html.data(), html.length()));
+
+        // no hash by default
+        //
+        cm::commonmark no_hash;
+        no_hash.process(input);
+        CATCH_REQUIRE(no_hash.get_output_hash() == cm::streaming_hash::hash("", 0));
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("cm: cache key")
+    {
+        cm::commonmark md;
+        std::uint64_t const key(md.get_cache_key("Some text.\nMore text.\n"));
+
+        // line endings are normalized
+        //
+        CATCH_REQUIRE(md.get_cache_key("Some text.\r\nMore text.\r\n") == key);
+        CATCH_REQUIRE(md.get_cache_key("Some text.\rMore text.\r") == key);
+        CATCH_REQUIRE(md.get_cache_key("Some text.\n\nMore text.\n") != key);
+        CATCH_REQUIRE(md.get_cache_key(std::string("a\0b", 3)) == md.get_cache_key("a\xEF\xBF\xBD" "b"));
+
+        // features which change the output change the key
+        //
+        cm::features f;
+        f.set_add_classes(true);
+        md.set_features(f);
+        CATCH_REQUIRE(md.get_cache_key("Some text.\nMore text.\n") != key);
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("commonmark_slow_document", "[direct-test][block]")
+{
+    CATCH_START_SECTION("cm: slow documents are reported")
+    {
+        std::string const input(
+                "# Title\n"
+                "\n"
+                "> * item\n"
+                ">   1. sub-item\n"
+                "\n"
+                "End.\n");
+
+        std::string const quarantine(SNAP_CATCH2_NAMESPACE::g_tmp_dir() + "/quarantine");
+        int called(0);
+        cm::commonmark::slow_document_t details;
+        cm::commonmark md;
+        md.set_slow_document_hook(
+                  std::chrono::steady_clock::duration()
+                , [&called, &details](cm::commonmark::slow_document_t const & d)
+                  {
+                      ++called;
+                      details = d;
+                  }
+                , quarantine);
+        md.process(input);
+
+        CATCH_REQUIRE(called == 1);
+        CATCH_REQUIRE(details.f_input_size == input.length());
+        CATCH_REQUIRE(details.f_input_hash == cm::streaming_hash::hash(input.data(), input.length()));
+        CATCH_REQUIRE(details.f_total_duration >= details.f_parse_duration + details.f_generate_duration);
+        CATCH_REQUIRE(details.f_block_count > 3);
+        CATCH_REQUIRE(details.f_max_depth >= 3);
+        CATCH_REQUIRE(details.f_quarantine_filename
+                        == quarantine + "/" + cm::streaming_hash::to_string(details.f_input_hash) + ".md");
+
+        std::ifstream in(details.f_quarantine_filename);
+        std::string saved((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        CATCH_REQUIRE(saved == input);
+
+        // fast documents are not reported
+        //
+        md.set_slow_document_hook(
+                  std::chrono::hours(1)
+                , [&called](cm::commonmark::slow_document_t const &)
+                  {
+                      ++called;
+                  });
+        md.process(input);
+        CATCH_REQUIRE(called == 1);
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("commonmark_stream", "[direct-test][block]")
+{
+    CATCH_START_SECTION("cm: stream with a forward reference")
+    {
+        cm::features f;
+        f.set_commonmark_compatible();
+        cm::commonmark md;
+        md.set_features(f);
+        md.start();
+
+        // the first paragraph is final once the next block starts
+        //
+        CATCH_REQUIRE(md.add_input("# Title\n\nSee [foo]") == "");
+        CATCH_REQUIRE(md.add_input(".\n\nMore text.\n") == "<h1>Title</h1>\n");
+
+        // the paragraph using [foo] is held until the definition appears
+        //
+        CATCH_REQUIRE(md.add_input("\nLast\n") == "");
+        CATCH_REQUIRE(md.add_input("\n[foo]: /url \"T\"\n\nEnd.\n")
+                == "<p>See <a href=\"/url\" title=\"T\">foo</a>.</p>\n"
+                   "<p>More text.</p>\n"
+                   "<p>Last</p>\n");
+        CATCH_REQUIRE(md.finish() == "<p>End.</p>\n");
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("cm: stream output equals the process() output")
+    {
+        std::string const input(
+                "[undefined] and [ref].\n"
+                "\n"
+                "* one\n"
+                "* two\n"
+                "\n"
+                "> quote\n"
+                "continued\n"
+                "\n"
+                "Heading\n"
+                "---\n"
+                "\n"
+                "[ref]:\n"
+                "/url\n"
+                "'title'\n");
+
+        cm::commonmark full;
+        std::string const expected(full.process(input));
+
+        for(std::size_t chunk(1); chunk < 20; ++chunk)
+        {
+            cm::commonmark md;
+            md.start();
+            std::string html;
+            for(std::size_t pos(0); pos < input.length(); pos += chunk)
+            {
+                html += md.add_input(input.substr(pos, chunk));
+            }
+            html += md.finish();
+            CATCH_REQUIRE(html == expected);
+        }
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("cm: stream with definitions right before a block")
+    {
+        char const * inputs[] =
+        {
+            "***\n[b]: /y \"t\"\n    indented\n[b]\n",
+            "para\n\n[b]: /y\n[c]: /z\n    indented\n[b] [c]\n",
+            "> [x]: /u\n    indented\n[x]\n",
+            "- a\n\n  [x]: /u\nnext [x]\n",
+            "[a]: /a\n\n[a]\n\n[b]: /b\n# h [b]\n",
+            "[a]:\n/url\n'title'\n    code\n[a]\n",
+        };
+        for(auto const & input : inputs)
+        {
+            std::string const in(input);
+            cm::commonmark full;
+            std::string const expected(full.process(in));
+
+            for(std::size_t chunk(1); chunk <= in.length(); ++chunk)
+            {
+                cm::commonmark md;
+                md.start();
+                std::string html;
+                for(std::size_t pos(0); pos < in.length(); pos += chunk)
+                {
+                    html += md.add_input(in.substr(pos, chunk));
+                }
+                html += md.finish();
+                CATCH_REQUIRE(html == expected);
+            }
+        }
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("cm: stream with brackets which cannot be references")
+    {
+        cm::features f;
+        f.set_commonmark_compatible();
+        cm::commonmark md;
+        md.set_features(f);
+        md.start();
+
+        // a blank label or a label with brackets cannot be defined later
+        //
+        CATCH_REQUIRE(md.add_input("[ ] todo\n\n[a [] c] text\n\nnext\n")
+                == "<p>[ ] todo</p>\n"
+                   "<p>[a [] c] text</p>\n");
+        CATCH_REQUIRE(md.add_input("\n[a [] c]: /url\n\n[d] last\n")
+                == "<p>next</p>\n"
+                   "<p>[a [] c]: /url</p>\n");
+        CATCH_REQUIRE(md.finish() == "<p>[d] last</p>\n");
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("cm: stream a large paragraph one line at a time")
+    {
+        std::string input;
+        cm::commonmark md;
+        md.start();
+        std::string html;
+        for(int idx(0); idx < 500; ++idx)
+        {
+            std::string const line("line " + std::to_string(idx) + " of a *large* paragraph\n");
+            input += line;
+            html += md.add_input(line);
+        }
+        CATCH_REQUIRE(html.empty());
+
+        // the blank line ends the paragraph so it does not wait for more
+        // input even though the large paragraph is not parsed each time
+        //
+        input += "\nnext\n";
+        html += md.add_input("\nnext\n");
+        CATCH_REQUIRE_FALSE(html.empty());
+        html += md.finish();
+
+        cm::commonmark full;
+        CATCH_REQUIRE(html == full.process(input));
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("cm: stream must be started")
+    {
+        cm::commonmark md;
+        CATCH_REQUIRE_THROWS_AS(md.add_input("text\n"), cm::commonmark_logic_error);
+        CATCH_REQUIRE_THROWS_AS(md.finish(), cm::commonmark_logic_error);
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("commonmark_list_tightness", "[direct-test][block]")
+{
+    CATCH_START_SECTION("cm: tight list")
+    {
+        cm::features f;
+        f.set_commonmark_compatible();
+        cm::commonmark md;
+        md.set_features(f);
+        CATCH_REQUIRE(md.process("- a\n- b\n") == "<ul>\n<li>a</li>\n<li>b</li>\n</ul>\n");
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("cm: loose list")
+    {
+        cm::features f;
+        f.set_commonmark_compatible();
+        cm::commonmark md;
+        md.set_features(f);
+        CATCH_REQUIRE(md.process("- a\n\n- b\n") == "<ul>\n<li>\n<p>a</p>\n</li>\n<li>\n<p>b</p>\n</li>\n</ul>\n");
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("cm: empty line after the last item of a list followed by a paragraph")
+    {
+        cm::features f;
+        f.set_commonmark_compatible();
+        cm::commonmark md;
+        md.set_features(f);
+        CATCH_REQUIRE(md.process("- a\n- b\n\npara\n") == "<ul>\n<li>a</li>\n<li>b</li>\n</ul>\n<p>para</p>\n");
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("cm: unlink the first item of a list following another list")
+    {
+        auto make_block = [](char32_t type)
+        {
+            cm::character c{};
+            c.f_char = type;
+            return std::make_shared<cm::block>(c);
+        };
+
+        cm::block::pointer_t document(make_block(cm::BLOCK_TYPE_DOCUMENT));
+        cm::block::pointer_t dash(make_block(cm::BLOCK_TYPE_LIST_DASH));
+        cm::block::pointer_t first(make_block(cm::BLOCK_TYPE_LIST_ASTERISK));
+        cm::block::pointer_t second(make_block(cm::BLOCK_TYPE_LIST_ASTERISK));
+        cm::block::pointer_t third(make_block(cm::BLOCK_TYPE_LIST_ASTERISK));
+        document->link_child(dash);
+        document->link_child(first);
+        document->link_child(second);
+        document->link_child(third);
+        first->followed_by_an_empty_line(true);
+        CATCH_REQUIRE_FALSE(second->is_tight_list());
+
+        // the "*" list now starts with "second" and it is tight
+        //
+        first->unlink();
+        CATCH_REQUIRE(dash->next() == second);
+        CATCH_REQUIRE(second->is_tight_list());
+        CATCH_REQUIRE(third->is_tight_list());
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("commonmark_inline_plain_text", "[direct-test][inline]")
+{
+    CATCH_START_SECTION("cm: plain text with UTF-8 and blanks")
+    {
+        cm::features f;
+        f.set_commonmark_compatible();
+        cm::commonmark md;
+        md.set_features(f);
+        CATCH_REQUIRE(md.process("caf\xC3\xA9 and  na\xC3\xAFve words\n") == "<p>caf\xC3\xA9 and  na\xC3\xAFve words</p>\n");
+        CATCH_REQUIRE(md.process("hard  \nbreak and trailing   \n") == "<p>hard<br />\nbreak and trailing</p>\n");
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("cm: dash and plus are plain only without the ins/del extension")
+    {
+        cm::features f;
+        f.set_commonmark_compatible();
+        f.set_ins_del_extension(false);
+        cm::commonmark md;
+        md.set_features(f);
+        CATCH_REQUIRE(md.process("a ++b++ c-d\n") == "<p>a ++b++ c-d</p>\n");
+
+        f.set_ins_del_extension(true);
+        md.set_features(f);
+        CATCH_REQUIRE(md.process("a ++b++ c-d\n") == "<p>a <ins>b</ins> c-d</p>\n");
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("commonmark_plain_text", "[direct-test][block]")
+{
+    CATCH_START_SECTION("cm: paragraphs of plain text")
+    {
+        cm::commonmark md;
+        CATCH_REQUIRE(md.process("") == "");
+        CATCH_REQUIRE(md.process("Hello world!\n") == "<p>Hello world!</p>\n");
+        CATCH_REQUIRE(md.process("He said \"2 > 1\", caf\xC3\xA9\r\nsecond line\r\n\r\n\nnext paragraph")
+                == "<p>He said &quot;2 &gt; 1&quot;, caf\xC3\xA9\nsecond line</p>\n<p>next paragraph</p>\n");
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("cm: same output as the parser")
+    {
+        // the block index turns off the plain text path
+        //
+        char const * inputs[] =
+        {
+            "plain text\nwith two lines\n\nand two paragraphs\n",
+            "2021 was a good year\n",
+            "2021. was a good year\n",
+            "see 3) below\n",
+            "> a quote\n",
+            "a hard  \nbreak\n",
+            "trailing spaces  \n",
+            "  indented\n",
+            "a setext heading\n===\n",
+            "a - b + c = d\n",
+            "- item\n",
+            "stars * and # hashes\n",
+            "bad \xE6\x97 utf-8\n",
+            "tab\there\n",
+        };
+        for(auto const & in : inputs)
+        {
+            cm::commonmark plain;
+            plain.set_compute_block_hashes();
+            cm::commonmark parsed;
+            parsed.set_compute_block_hashes();
+            parsed.set_build_block_index();
+
+            CATCH_REQUIRE(plain.process(in) == parsed.process(in));
+            CATCH_REQUIRE(plain.get_block_hashes().size() == parsed.get_block_hashes().size());
+            for(std::size_t idx(0); idx < plain.get_block_hashes().size(); ++idx)
+            {
+                CATCH_REQUIRE(plain.get_block_hashes()[idx].f_hash == parsed.get_block_hashes()[idx].f_hash);
+                CATCH_REQUIRE(plain.get_block_hashes()[idx].f_offset == parsed.get_block_hashes()[idx].f_offset);
+                CATCH_REQUIRE(plain.get_block_hashes()[idx].f_size == parsed.get_block_hashes()[idx].f_size);
+            }
+        }
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("cm: document div")
+    {
+        cm::features f;
+        f.set_add_document_div();
+        f.set_add_classes();
+        cm::commonmark md;
+        md.set_features(f);
+        CATCH_REQUIRE(md.process("one\n\ntwo\n") == "<div class=\"cm-document\"><p>one</p>\n<p>two</p>\n</div>");
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("commonmark_process_inline", "[direct-test][inline]")
+{
+    CATCH_START_SECTION("cm: inline markup without a paragraph")
+    {
+        cm::commonmark md;
+        CATCH_REQUIRE(md.process_inline("Hi *there*!") == "Hi <em>there</em>!");
+        CATCH_REQUIRE(md.process_inline("  A `title` with [a link](/x \"t\") and **bold**  ")
+                == "A <code>title</code> with <a href=\"/x\" title=\"t\">a link</a> and <strong>bold</strong>");
+        CATCH_REQUIRE(md.process_inline("a < b & c") == "a &lt; b &amp; c");
+        CATCH_REQUIRE(md.process_inline("# not a header") == "# not a header");
+        CATCH_REQUIRE(md.process_inline("") == "");
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("cm: multiple lines are one paragraph")
+    {
+        cm::commonmark md;
+        CATCH_REQUIRE(md.process_inline("line one  \n   line two\r\nline three\n") == "line one<br/>\nline two\nline three");
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("cm: same output as process() without the <p> tag")
+    {
+        char const * inputs[] =
+        {
+            "plain words",
+            "_emphasis_ and __strong__ and ***both***",
+            "code `a < b` and ``x ` y``",
+            "auto <http://example.com/> and <span>html</span>",
+            "entity &copy; and escaped \\*star\\*",
+            "![image](/i.png \"title\")!",
+        };
+        for(auto const & in : inputs)
+        {
+            cm::commonmark md;
+            std::string const html(md.process(std::string(in) + "\n"));
+            CATCH_REQUIRE(html == "<p>" + md.process_inline(in) + "</p>\n");
+        }
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("cm: links added with add_link() are found")
+    {
+        cm::commonmark md;
+        md.add_link("docs", "/docs", "", true);
+        CATCH_REQUIRE(md.process_inline("see [docs]") == "see <a href=\"/docs\">docs</a>");
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("cm: input without a final line feed does not affect the next call")
+    {
+        cm::commonmark md;
+        CATCH_REQUIRE(md.process("*one*") == "<p><em>one</em></p>\n");
+        CATCH_REQUIRE(md.process("*two*") == "<p><em>two</em></p>\n");
+        CATCH_REQUIRE(md.process_inline("*three*") == "<em>three</em>");
+        CATCH_REQUIRE(md.process("*four*") == "<p><em>four</em></p>\n");
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("commonmark_process_inline_benchmark", "[.][benchmark][inline]")
+{
+    CATCH_START_SECTION("cm: latency of short strings with process() and process_inline()")
+    {
+        char const * inputs[] =
+        {
+            "Release notes for *version 2.1*",
+            "@alex can you check `make test` on [the build farm](https://build.example.com/)? it fails **again**",
+            "Label",
+            "A slightly longer chat line with _some_ emphasis, a <https://example.com/> autolink, and an &amp; entity.",
+        };
+        constexpr int iterations(2000);
+
+        cm::commonmark md;
+        std::chrono::steady_clock::duration full(0);
+        std::chrono::steady_clock::duration inline_only(0);
+        for(auto const & in : inputs)
+        {
+            std::string const s(in);
+            CATCH_REQUIRE(s.length() < 200);
+
+            std::chrono::steady_clock::time_point const start(std::chrono::steady_clock::now());
+            for(int idx(0); idx < iterations; ++idx)
+            {
+                md.process(s);
+            }
+            std::chrono::steady_clock::time_point const middle(std::chrono::steady_clock::now());
+            for(int idx(0); idx < iterations; ++idx)
+            {
+                md.process_inline(s);
+            }
+            std::chrono::steady_clock::time_point const end(std::chrono::steady_clock::now());
+
+            full += middle - start;
+            inline_only += end - middle;
+        }
+
+        std::size_t const calls(iterations * (sizeof(inputs) / sizeof(inputs[0])));
+        std::cout << "process():        "
+                  << std::chrono::duration_cast<std::chrono::nanoseconds>(full).count() / calls
+                  << " ns per call\n"
+                  << "process_inline(): "
+                  << std::chrono::duration_cast<std::chrono::nanoseconds>(inline_only).count() / calls
+                  << " ns per call\n";
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("commonmark_inline_code", "[direct-test][inline]")
+{
+    CATCH_START_SECTION("cm: closing mark must have the same length")
+    {
+        cm::features f;
+        f.set_commonmark_compatible();
+        cm::commonmark md;
+        md.set_features(f);
+        CATCH_REQUIRE(md.process("`foo``bar``\n") == "<p>`foo<code>bar</code></p>\n");
+        CATCH_REQUIRE(md.process("``foo`bar``\n") == "<p><code>foo`bar</code></p>\n");
+        CATCH_REQUIRE(md.process("a ``` b `` c ` d ` e\n") == "<p>a ``` b `` c <code>d</code> e</p>\n");
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("cm: unmatched mark at the end of the paragraph")
+    {
+        cm::features f;
+        f.set_commonmark_compatible();
+        cm::commonmark md;
+        md.set_features(f);
+        CATCH_REQUIRE(md.process("``//\n`\n") == "<p>``//\n`</p>\n");
+        CATCH_REQUIRE(md.process("```foo``\n") == "<p>```foo``</p>\n");
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("cm: many runs of mismatched lengths")
+    {
+        cm::features f;
+        f.set_commonmark_compatible();
+        cm::commonmark md;
+        md.set_features(f);
+        std::string input;
+        std::string expected("<p>");
+        for(int i(1); i <= 200; ++i)
+        {
+            input += std::string(i, '`') + "x ";
+            expected += std::string(i, '`') + "x ";
+        }
+        input += "end\n";
+        expected += "end</p>\n";
+        CATCH_REQUIRE(md.process(input) == expected);
+    }
+    CATCH_END_SECTION()
+}
+
+
+namespace
+{
+
+
+class mention_extension
+    : public cm::inline_extension
+{
+public:
+    mention_extension()
+        : inline_extension("@")
+    {
+    }
+
+    virtual bool convert(
+              cm::character::string_t const & line
+            , cm::character::string_t::const_iterator & it
+            , std::string & result) override
+    {
+        std::string name;
+        auto et(it + 1);
+        for(; et != line.cend() && (et->is_ascii_letter() || et->is_digit() || et->f_char == U'_'); ++et)
+        {
+            name += static_cast<char>(et->f_char);
+        }
+        if(name.empty())
+        {
+            return false;
+        }
+        result += "<a href=\"/u/" + name + "\">@" + name + "</a>";
+        it = et;
+        return true;
+    }
+};
+
+
+
+
+class container_extension
+    : public cm::block_extension
+{
+public:
+    container_extension()
+        : block_extension(":")
+    {
+    }
+
+    virtual bool convert(
+              cm::character::string_t const & line
+            , cm::character::string_t::const_iterator it
+            , get_line_t get_line
+            , std::string & result) override
+    {
+        // ":::<name>" opens a container, ":::" closes it
+        //
+        std::string const start(cm::character::to_utf8(cm::character::string_t(it, line.cend())));
+        if(start.length() <= 3
+        || start.compare(0, 3, ":::") != 0)
+        {
+            return false;
+        }
+        result += "<div class=\"" + start.substr(3) + "\">\n";
+        while(get_line())
+        {
+            std::string const l(cm::character::to_utf8(line));
+            if(l == ":::")
+            {
+                break;
+            }
+            result += l + '\n';
+        }
+        result += "</div>\n";
+        return true;
+    }
+};
+
+
+}
+// no name namespace
+
+
+CATCH_TEST_CASE("commonmark_link_references", "[direct-test][inline]")
+{
+    CATCH_START_SECTION("cm: references do not leak to the next document")
+    {
+        cm::features f;
+        f.set_commonmark_compatible();
+        cm::commonmark md;
+        md.set_features(f);
+        CATCH_REQUIRE(md.process("[a]: /first\n\n[a]\n") == "<p><a href=\"/first\">a</a></p>\n");
+        CATCH_REQUIRE(md.process("[a]: /second\n\n[a]\n") == "<p><a href=\"/second\">a</a></p>\n");
+        CATCH_REQUIRE(md.process("[a]\n") == "<p>[a]</p>\n");
+        CATCH_REQUIRE(md.process_inline("[a]") == "[a]");
+
+        md.start();
+        std::string html(md.add_input("[a]: /stream\n\n"));
+        html += md.finish();
+        CATCH_REQUIRE(md.process("[a]\n") == "<p>[a]</p>\n");
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("cm: links added with add_link() are kept")
+    {
+        cm::features f;
+        f.set_commonmark_compatible();
+        cm::commonmark md;
+        md.set_features(f);
+        md.add_link("b", "/user", "", true);
+        CATCH_REQUIRE(md.process("[b]: /document\n\n[a]: /first\n\n[a] [b]\n")
+                == "<p><a href=\"/first\">a</a> <a href=\"/user\">b</a></p>\n");
+        CATCH_REQUIRE(md.process("[a] [b]\n") == "<p>[a] <a href=\"/user\">b</a></p>\n");
+        CATCH_REQUIRE(md.process_inline("[a] [b]") == "[a] <a href=\"/user\">b</a>");
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("commonmark_inline_extension", "[direct-test][inline]")
+{
+    CATCH_START_SECTION("cm: mention extension")
+    {
+        cm::features f;
+        f.set_commonmark_compatible();
+        cm::commonmark md;
+        md.set_features(f);
+        CATCH_REQUIRE(md.process("hi @alexis, *see @bob*\n") == "<p>hi @alexis, <em>see @bob</em></p>\n");
+
+        md.add_inline_extension(std::make_shared<mention_extension>());
+        CATCH_REQUIRE(md.process("hi @alexis, *see @bob*\n") == "<p>hi <a href=\"/u/alexis\">@alexis</a>, <em>see <a href=\"/u/bob\">@bob</a></em></p>\n");
+
+        // not a mention, the '@' is kept as is
+        //
+        CATCH_REQUIRE(md.process("mail @ home and `@code`\n") == "<p>mail @ home and <code>@code</code></p>\n");
+
+        // the table is rebuilt when the features change
+        //
+        md.set_features(f);
+        CATCH_REQUIRE(md.process("@bob\n") == "<p><a href=\"/u/bob\">@bob</a></p>\n");
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("cm: invalid inline extensions")
+    {
+        cm::commonmark md;
+        CATCH_REQUIRE_THROWS_AS(md.add_inline_extension(cm::inline_extension::pointer_t()), cm::unexpected_null_pointer);
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("commonmark_block_extension", "[direct-test][block]")
+{
+    CATCH_START_SECTION("cm: container extension")
+    {
+        cm::features f;
+        f.set_commonmark_compatible();
+        cm::commonmark md;
+        md.set_features(f);
+        std::string const input("para\n\n:::note\nsome text\n:::\n\nafter ::: that\n\n:::\n");
+        std::string const plain(md.process(input));
+        CATCH_REQUIRE(plain == "<p>para</p>\n<p>:::note\nsome text\n:::</p>\n<p>after ::: that</p>\n<p>:::</p>\n");
+
+        md.add_block_extension(std::make_shared<container_extension>());
+        CATCH_REQUIRE(md.process(input) == "<p>para</p>\n<div class=\"note\">\nsome text\n</div>\n<p>after ::: that</p>\n<p>:::</p>\n");
+
+        // the default block starters still work
+        //
+        CATCH_REQUIRE(md.process("# title\n:::x\n- item\n") == "<h1>title</h1>\n<div class=\"x\">\n- item\n</div>\n");
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("cm: block extensions are not used inside containers")
+    {
+        cm::features f;
+        f.set_commonmark_compatible();
+        cm::commonmark plain;
+        plain.set_features(f);
+        cm::commonmark md;
+        md.set_features(f);
+        md.add_block_extension(std::make_shared<container_extension>());
+
+        // the rest of the document must not be swallowed by the extension
+        //
+        char const * inputs[] =
+        {
+            "> :::note\n> some text\n> :::\n\nafter\n",
+            "- :::note\n  some text\n  :::\n\nafter\n",
+            "> - :::note\n>   some text\n>   :::\n\nafter\n",
+        };
+        for(auto const & in : inputs)
+        {
+            std::string const html(md.process(in));
+            CATCH_REQUIRE(html == plain.process(in));
+            CATCH_REQUIRE(html.find("<div") == std::string::npos);
+            CATCH_REQUIRE(html.find("<p>after</p>") != std::string::npos);
+        }
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("cm: invalid block extensions")
+    {
+        cm::commonmark md;
+        CATCH_REQUIRE_THROWS_AS(md.add_block_extension(cm::block_extension::pointer_t()), cm::unexpected_null_pointer);
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("commonmark_fingerprint", "[direct-test][features]")
+{
+    CATCH_START_SECTION("cm: each feature changes the fingerprint")
+    {
+        std::set<std::uint64_t> fingerprints;
+
+        cm::features f;
+        fingerprints.insert(f.fingerprint());
+        CATCH_REQUIRE(cm::features().fingerprint() == f.fingerprint());
+
+        f.set_add_document_div(true);
+        fingerprints.insert(f.fingerprint());
+        f.set_add_classes(true);
+        fingerprints.insert(f.fingerprint());
+        f.set_add_space_in_empty_tag(true);
+        fingerprints.insert(f.fingerprint());
+        f.set_convert_entities(false);
+        fingerprints.insert(f.fingerprint());
+        f.set_ins_del_extension(false);
+        fingerprints.insert(f.fingerprint());
+        f.set_remove_unknown_references(false);
+        fingerprints.insert(f.fingerprint());
+        f.set_line_feed("\n");
+        fingerprints.insert(f.fingerprint());
+        f.set_line_feed("\r\n");
+        fingerprints.insert(f.fingerprint());
+
+        CATCH_REQUIRE(fingerprints.size() == 9);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("cm: settings change the commonmark fingerprint")
+    {
+        std::set<std::uint64_t> fingerprints;
+
+        cm::commonmark md;
+        CATCH_REQUIRE(md.fingerprint() != md.get_features().fingerprint());
+        CATCH_REQUIRE(md.fingerprint() == cm::commonmark().fingerprint());
+        fingerprints.insert(md.fingerprint());
+
+        md.add_inline_extension(std::make_shared<mention_extension>());
+        fingerprints.insert(md.fingerprint());
+        md.add_block_extension(std::make_shared<container_extension>());
+        fingerprints.insert(md.fingerprint());
+        md.set_code_renderer("math", [](std::string const &, std::string const &, std::string &) {});
+        fingerprints.insert(md.fingerprint());
+        md.set_link_rewriter([](bool, std::string &, std::string &) {});
+        fingerprints.insert(md.fingerprint());
+        cm::sanitizer::pointer_t s(std::make_shared<cm::sanitizer>());
+        md.set_sanitizer(s);
+        fingerprints.insert(md.fingerprint());
+        s->allow_tag("video", "src");
+        fingerprints.insert(md.fingerprint());
+
+        CATCH_REQUIRE(fingerprints.size() == 7);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("cm: links added with add_link() change the fingerprint")
+    {
+        std::set<std::uint64_t> fingerprints;
+
+        cm::commonmark md;
+        fingerprints.insert(md.fingerprint());
+        md.add_link("a", "/a", "", true);
+        fingerprints.insert(md.fingerprint());
+
+        cm::commonmark other;
+        other.add_link("a", "/b", "", true);
+        fingerprints.insert(other.fingerprint());
+        other.add_link("a", "/c", "title", false);
+        fingerprints.insert(other.fingerprint());
+
+        cm::commonmark title;
+        title.add_link("a", "/a", "title", true);
+        fingerprints.insert(title.fingerprint());
+
+        cm::commonmark inline_link;
+        inline_link.add_link("a", "/a", "", false);
+        fingerprints.insert(inline_link.fingerprint());
+
+        CATCH_REQUIRE(fingerprints.size() == 6);
+        CATCH_REQUIRE(md.get_cache_key("[a]\n") != inline_link.get_cache_key("[a]\n"));
+
+        // the references of a document do not change the fingerprint
+        //
+        std::uint64_t const before(md.fingerprint());
+        md.process("[b]: /b\n\n[b]\n");
+        CATCH_REQUIRE(md.fingerprint() == before);
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("commonmark_code_renderer", "[direct-test][block]")
+{
+    CATCH_START_SECTION("cm: code renderer by language")
+    {
+        cm::features f;
+        f.set_commonmark_compatible();
+        cm::commonmark md;
+        md.set_features(f);
+        md.set_code_renderer(
+              "cpp"
+            , [](std::string const & code, std::string const & info_string, std::string & output)
+              {
+                  output += "[" + code + "|" + info_string + "]";
+              });
+
+        CATCH_REQUIRE(md.process("```cpp lines\nint a < b;\n```\n") == "<pre><code class=\"language-cpp\">[int a < b;\n|cpp lines]</code></pre>\n");
+
+        // no renderer for this language, use the default escaping
+        //
+        CATCH_REQUIRE(md.process("```py\nx < y\n```\n") == "<pre><code class=\"language-py\">x &lt; y\n</code></pre>\n");
+
+        md.set_code_renderer("cpp", cm::commonmark::code_renderer_t());
+        CATCH_REQUIRE(md.process("```cpp\nint a < b;\n```\n") == "<pre><code class=\"language-cpp\">int a &lt; b;\n</code></pre>\n");
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("cm: code renderer assigning its output")
+    {
+        cm::features f;
+        f.set_commonmark_compatible();
+        cm::commonmark md;
+        md.set_features(f);
+        md.set_compute_block_hashes();
+        md.set_code_renderer(
+              "math"
+            , [](std::string const &, std::string const &, std::string & output)
+              {
+                  CATCH_REQUIRE(output.empty());
+                  output = "x";
+              });
+
+        std::string const html(md.process("# Title\n\n```math\n1 + 1\n```\n\nEnd.\n"));
+        CATCH_REQUIRE(html ==
+                  "<h1>Title</h1>\n"
+                  "<pre><code class=\"language-math\">x</code></pre>\n"
+                  "<p>End.</p>\n");
+
+        cm::commonmark::block_hash_t::vector_t const & hashes(md.get_block_hashes());
+        CATCH_REQUIRE(hashes.size() == 3);
+        CATCH_REQUIRE(hashes[1].f_offset == 15);
+        CATCH_REQUIRE(html.substr(hashes[1].f_offset, hashes[1].f_size)
+                == "<pre><code class=\"language-math\">x</code></pre>\n");
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("commonmark_link_rewriter", "[direct-test][inline]")
+{
+    CATCH_START_SECTION("cm: rewrite link and image destinations")
+    {
+        cm::features f;
+        f.set_commonmark_compatible();
+        cm::commonmark md;
+        md.set_features(f);
+        md.set_link_rewriter(
+              [](bool is_image, std::string & destination, std::string & attributes)
+              {
+                  if(is_image)
+                  {
+                      destination = "https://cdn.example.com/" + destination;
+                      attributes += " loading=\"lazy\"";
+                  }
+                  else if(destination.find(':') == std::string::npos)
+                  {
+                      destination = "/docs/" + destination;
+                  }
+              });
+
+        CATCH_REQUIRE(md.process("![alt](img/a.png \"t\") and [doc](page.html) and <https://x.org>\n")
+                == "<p><img src=\"https://cdn.example.com/img/a.png\" alt=\"alt\" title=\"t\" loading=\"lazy\">"
+                   " and <a href=\"/docs/page.html\">doc</a>"
+                   " and <a href=\"https://x.org\">https://x.org</a></p>\n");
+
+        md.set_link_rewriter(cm::commonmark::link_rewriter_t());
+        CATCH_REQUIRE(md.process("[doc](page.html)\n") == "<p><a href=\"page.html\">doc</a></p>\n");
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("commonmark_sanitizer", "[direct-test][sanitizer]")
+{
+    CATCH_START_SECTION("cm: sanitize inline tags")
+    {
+        cm::features f;
+        f.set_commonmark_compatible();
+        cm::commonmark md;
+        md.set_features(f);
+        std::string const input("a <b class=\"x\" onclick=\"evil()\">bold</b> <script>alert(1)</script>\n");
+        CATCH_REQUIRE(md.process(input) == "<p>a <b class=\"x\" onclick=\"evil()\">bold</b> <script>alert(1)</script></p>\n");
+
+        md.set_sanitizer(std::make_shared<cm::sanitizer>());
+        CATCH_REQUIRE(md.process(input) == "<p>a <b>bold</b> &lt;script&gt;alert(1)&lt;/script&gt;</p>\n");
+        CATCH_REQUIRE(md.process("<a href=\"/rel\" title=ok>r</a> <a href='javascript:x'>j</a> <br/>\n")
+                == "<p><a href=\"/rel\" title=\"ok\">r</a> <a>j</a> <br /></p>\n");
+
+        md.set_sanitizer(cm::sanitizer::pointer_t());
+        CATCH_REQUIRE(md.process(input) == "<p>a <b class=\"x\" onclick=\"evil()\">bold</b> <script>alert(1)</script></p>\n");
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("cm: sanitize HTML blocks")
+    {
+        cm::features f;
+        f.set_commonmark_compatible();
+        cm::commonmark md;
+        md.set_features(f);
+        md.set_sanitizer(std::make_shared<cm::sanitizer>());
+        CATCH_REQUIRE(md.process("<div onclick=\"x\">\n<img src=\"javascript:alert(1)\" alt='a \"q\"'><!-- hidden --><iframe src=x>\n</div>\n")
+                == "<div>\n<img alt=\"a &quot;q&quot;\">&lt;iframe src=x>\n</div>\n");
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("cm: sanitize link destinations")
+    {
+        cm::features f;
+        f.set_commonmark_compatible();
+        cm::commonmark md;
+        md.set_features(f);
+        md.set_sanitizer(std::make_shared<cm::sanitizer>());
+        CATCH_REQUIRE(md.process("[x](javascript:alert(1)) [y](https://ok.org) ![i](JaVaScRiPt:x)\n")
+                == "<p><a href=\"\">x</a> <a href=\"https://ok.org\">y</a> <img src=\"\" alt=\"i\"></p>\n");
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("commonmark_deep_nesting", "[direct-test][block]")
+{
+    CATCH_START_SECTION("cm: deeply nested lists do not use the stack")
+    {
+        // the generator and tree walkers use an explicit stack so the
+        // depth of the document is not limited by the thread stack size
+        //
+        int const depth(3'000);
+        std::string input;
+        for(int idx(0); idx < depth; ++idx)
+        {
+            input += "- ";
+        }
+        input += "a\n";
+
+        cm::commonmark md;
+        std::string const html(md.process(input));
+
+        std::string::size_type pos(0);
+        int count(0);
+        for(;;)
+        {
+            pos = html.find("<ul>\n<li>", pos);
+            if(pos == std::string::npos)
+            {
+                break;
+            }
+            ++count;
+            ++pos;
+        }
+        CATCH_REQUIRE(count == depth);
+        CATCH_REQUIRE(html.find("<li>a</li>") != std::string::npos);
+    }
+    CATCH_END_SECTION()
+}
+
+
 CATCH_TEST_CASE("commonmark_test_suite", "[test-suite]")
 {
     CATCH_START_SECTION("cm: run against commonmark test suite")
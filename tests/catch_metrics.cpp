@@ -0,0 +1,124 @@
+// Copyright (c) 2021-2022  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/commonmarkcpp
+// contact@m2osw.com
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+// self
+//
+#include    "catch_main.h"
+
+
+// commonmarkcpp lib
+//
+#include    <commonmarkcpp/commonmark.h>
+#include    <commonmarkcpp/metrics.h>
+
+
+// C++ lib
+//
+#include    <thread>
+
+
+
+namespace
+{
+
+
+
+std::string metric_line(std::string const & metrics, std::string const & name)
+{
+    std::string::size_type const pos(metrics.find("\n" + name + " "));
+    if(pos == std::string::npos)
+    {
+        return std::string();
+    }
+    std::string::size_type const end(metrics.find('\n', pos + 1));
+    return metrics.substr(pos + 1, end - pos - 1);
+}
+
+
+
+}
+// no name namespace
+
+
+
+CATCH_TEST_CASE("metrics", "[metrics]")
+{
+    CATCH_START_SECTION("cm: process() updates the metrics")
+    {
+        cm::metrics::reset();
+
+        cm::commonmark md;
+        std::string const input("# Title\n\nSome text.\n");
+        std::string const html(md.process(input));
+        md.process(input);
+
+        std::string const m(cm::metrics::to_prometheus());
+        CATCH_REQUIRE(m.find("# TYPE commonmark_documents_total counter\n") != std::string::npos);
+        CATCH_REQUIRE(metric_line(m, "commonmark_documents_total") == "commonmark_documents_total 2");
+        CATCH_REQUIRE(metric_line(m, "commonmark_input_bytes_total")
+                        == "commonmark_input_bytes_total " + std::to_string(input.length() * 2));
+        CATCH_REQUIRE(metric_line(m, "commonmark_output_bytes_total")
+                        == "commonmark_output_bytes_total " + std::to_string(html.length() * 2));
+        CATCH_REQUIRE(metric_line(m, "commonmark_cache_hits_total") == "commonmark_cache_hits_total 0");
+
+        CATCH_REQUIRE(m.find("# TYPE commonmark_phase_duration_seconds histogram\n") != std::string::npos);
+        CATCH_REQUIRE(m.find("commonmark_phase_duration_seconds_bucket{phase=\"parse\",le=\"+Inf\"} 2\n") != std::string::npos);
+        CATCH_REQUIRE(m.find("commonmark_phase_duration_seconds_count{phase=\"generate\"} 2\n") != std::string::npos);
+        CATCH_REQUIRE(m.find("commonmark_phase_duration_seconds_count{phase=\"total\"} 2\n") != std::string::npos);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("cm: counters of all the threads are merged")
+    {
+        cm::metrics::reset();
+
+        std::vector<std::thread> threads;
+        for(int idx(0); idx < 4; ++idx)
+        {
+            threads.emplace_back([]()
+                {
+                    for(int count(0); count < 10; ++count)
+                    {
+                        cm::metrics::add_document(100, 200);
+                        cm::metrics::add_duration(cm::metrics_phase_t::METRICS_PHASE_TOTAL, std::chrono::milliseconds(2));
+                    }
+                });
+        }
+        for(auto & t : threads)
+        {
+            t.join();
+        }
+
+        // the counts of threads which exited are kept
+        //
+        std::string const m(cm::metrics::to_prometheus());
+        CATCH_REQUIRE(metric_line(m, "commonmark_documents_total") == "commonmark_documents_total 40");
+        CATCH_REQUIRE(metric_line(m, "commonmark_input_bytes_total") == "commonmark_input_bytes_total 4000");
+        CATCH_REQUIRE(metric_line(m, "commonmark_output_bytes_total") == "commonmark_output_bytes_total 8000");
+        CATCH_REQUIRE(m.find("commonmark_phase_duration_seconds_bucket{phase=\"total\",le=\"0.001\"} 0\n") != std::string::npos);
+        CATCH_REQUIRE(m.find("commonmark_phase_duration_seconds_bucket{phase=\"total\",le=\"0.0025\"} 40\n") != std::string::npos);
+        CATCH_REQUIRE(m.find("commonmark_phase_duration_seconds_sum{phase=\"total\"} 0.08\n") != std::string::npos);
+        CATCH_REQUIRE(m.find("commonmark_phase_duration_seconds_count{phase=\"parse\"} 0\n") != std::string::npos);
+    }
+    CATCH_END_SECTION()
+}
+
+
+
+// vim: ts=4 sw=4 et
@@ -0,0 +1,225 @@
+// Copyright (c) 2021-2022  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/commonmarkcpp
+// contact@m2osw.com
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+// self
+//
+#include    "catch_main.h"
+
+
+// commonmarkcpp lib
+//
+#include    <commonmarkcpp/commonmark.h>
+#include    <commonmarkcpp/deflate_sink.h>
+#include    <commonmarkcpp/exception.h>
+#include    <commonmarkcpp/streaming_hash.h>
+#include    <commonmarkcpp/string_sink.h>
+
+
+// C lib
+//
+#include    <zlib.h>
+
+
+
+namespace
+{
+
+
+
+std::string inflate_all(std::string const & compressed, int window_bits)
+{
+    z_stream s = {};
+    CATCH_REQUIRE(inflateInit2(&s, window_bits) == Z_OK);
+
+    std::string result;
+    char buffer[1024];
+    s.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(compressed.data()));
+    s.avail_in = static_cast<uInt>(compressed.length());
+    int r(Z_OK);
+    do
+    {
+        s.next_out = reinterpret_cast<Bytef *>(buffer);
+        s.avail_out = sizeof(buffer);
+        r = inflate(&s, Z_NO_FLUSH);
+        CATCH_REQUIRE((r == Z_OK || r == Z_STREAM_END));
+        result.append(buffer, sizeof(buffer) - s.avail_out);
+    }
+    while(r != Z_STREAM_END);
+    inflateEnd(&s);
+
+    return result;
+}
+
+
+std::string const g_markdown(
+        "# Title\n"
+        "\n"
+        "Some *emphasis* and `code` in a paragraph.\n"
+        "\n"
+        "> a blockquote\n"
+        "> with two lines\n"
+        "\n"
+        "- item 1\n"
+        "- item 2\n"
+        "\n"
+        "```\n"
+        "code block\n"
+        "```\n");
+
+
+
+}
+// no name namespace
+
+
+
+CATCH_TEST_CASE("output_sink", "[sink]")
+{
+    CATCH_START_SECTION("cm: string sink")
+    {
+        cm::string_sink s;
+        s.write("<p>");
+        s.write("hello</p>", 5);
+        CATCH_REQUIRE(s.str() == "<p>hello");
+        s.finish();
+        CATCH_REQUIRE(s.str() == "<p>hello");
+        s.clear();
+        CATCH_REQUIRE(s.str().empty());
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("cm: process() to a string sink")
+    {
+        cm::commonmark expected_cm;
+        std::string const expected(expected_cm.process(g_markdown));
+
+        cm::commonmark cm;
+        cm::string_sink s;
+        cm.process(g_markdown, s);
+        CATCH_REQUIRE(s.str() == expected);
+
+        // the block hashes use offsets in the whole document
+        //
+        cm::commonmark hashes_cm;
+        hashes_cm.set_compute_block_hashes();
+        cm::features f;
+        f.set_add_document_div(true);
+        hashes_cm.set_features(f);
+        expected_cm.set_features(f);
+        std::string const with_div(expected_cm.process(g_markdown));
+        s.clear();
+        hashes_cm.process(g_markdown, s);
+        CATCH_REQUIRE(s.str() == with_div);
+        cm::commonmark::block_hash_t::vector_t const & hashes(hashes_cm.get_block_hashes());
+        CATCH_REQUIRE(hashes.size() == 5);
+        for(auto const & h : hashes)
+        {
+            CATCH_REQUIRE(h.f_offset + h.f_size <= with_div.length());
+            CATCH_REQUIRE(h.f_hash == cm::streaming_hash::hash(with_div.data() + h.f_offset, h.f_size));
+        }
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("deflate_sink", "[sink]")
+{
+    CATCH_START_SECTION("cm: compress output in all formats")
+    {
+        cm::commonmark expected_cm;
+        std::string const expected(expected_cm.process(g_markdown));
+
+        struct format_t
+        {
+            cm::deflate_format_t    f_format;
+            int                     f_window_bits;
+        };
+        format_t const formats[] =
+        {
+            { cm::deflate_format_t::DEFLATE_FORMAT_ZLIB, 15 },
+            { cm::deflate_format_t::DEFLATE_FORMAT_GZIP, 15 + 16 },
+            { cm::deflate_format_t::DEFLATE_FORMAT_RAW, -15 },
+        };
+        for(auto const & f : formats)
+        {
+            cm::string_sink::pointer_t out(std::make_shared<cm::string_sink>());
+            cm::deflate_sink d(out, f.f_format, 9);
+
+            cm::commonmark cm;
+            cm.process(g_markdown, d);
+
+            CATCH_REQUIRE(d.total_in() == expected.length());
+            CATCH_REQUIRE(d.total_out() == out->str().length());
+            CATCH_REQUIRE(inflate_all(out->str(), f.f_window_bits) == expected);
+
+            // a second finish() does nothing
+            //
+            d.finish();
+            CATCH_REQUIRE(d.total_out() == out->str().length());
+        }
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("cm: compress a large document")
+    {
+        std::string markdown;
+        for(int idx(0); idx < 2000; ++idx)
+        {
+            markdown += "Paragraph number " + std::to_string(idx) + " with *some* text.\n\n";
+        }
+        cm::commonmark expected_cm;
+        std::string const expected(expected_cm.process(markdown));
+
+        cm::string_sink::pointer_t out(std::make_shared<cm::string_sink>());
+        cm::deflate_sink d(out);
+        cm::commonmark cm;
+        cm.process(markdown, d);
+
+        CATCH_REQUIRE(out->str().length() < expected.length());
+        CATCH_REQUIRE(inflate_all(out->str(), 15 + 16) == expected);
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("deflate_sink_errors", "[sink][error]")
+{
+    CATCH_START_SECTION("cm: invalid parameters")
+    {
+        CATCH_REQUIRE_THROWS_AS(cm::deflate_sink(cm::output_sink::pointer_t()), cm::unexpected_null_pointer);
+
+        cm::string_sink::pointer_t out(std::make_shared<cm::string_sink>());
+        CATCH_REQUIRE_THROWS_AS(cm::deflate_sink(out, cm::deflate_format_t::DEFLATE_FORMAT_ZLIB, 10), cm::commonmark_out_of_range);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("cm: write after finish")
+    {
+        cm::string_sink::pointer_t out(std::make_shared<cm::string_sink>());
+        cm::deflate_sink d(out);
+        d.write("<p>data</p>\n");
+        d.finish();
+        CATCH_REQUIRE_THROWS_AS(d.write("more"), cm::already_flushed);
+    }
+    CATCH_END_SECTION()
+}
+
+
+
+// vim: ts=4 sw=4 et
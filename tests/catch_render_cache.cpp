@@ -0,0 +1,270 @@
+// Copyright (c) 2021-2022  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/commonmarkcpp
+// contact@m2osw.com
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+// self
+//
+#include    "catch_main.h"
+
+
+// commonmarkcpp lib
+//
+#include    <commonmarkcpp/commonmark.h>
+#include    <commonmarkcpp/exception.h>
+#include    <commonmarkcpp/render_cache.h>
+
+
+// C++ lib
+//
+#include    <atomic>
+#include    <thread>
+#include    <vector>
+
+
+// C lib
+//
+#include    <unistd.h>
+
+
+
+namespace
+{
+
+
+
+std::string cache_path(std::string const & name)
+{
+    std::string const path(SNAP_CATCH2_NAMESPACE::g_tmp_dir() + "/" + name);
+    unlink((path + "/index").c_str());
+    unlink((path + "/data").c_str());
+    return path;
+}
+
+
+
+}
+// no name namespace
+
+
+
+CATCH_TEST_CASE("render_cache", "[cache]")
+{
+    CATCH_START_SECTION("cm: store and find documents")
+    {
+        std::string const path(cache_path("store-and-find"));
+        cm::render_cache cache(path);
+        CATCH_REQUIRE(cache.path() == path);
+        CATCH_REQUIRE(cache.max_size() == cm::render_cache::DEFAULT_MAX_SIZE);
+        CATCH_REQUIRE(cache.count() == 0);
+
+        std::string html;
+        CATCH_REQUIRE_FALSE(cache.find(123, html));
+
+        cache.store(123, "<p>one</p>\n");
+        cache.store(456, "<p>two</p>\n");
+        cache.store(0, "<p>zero</p>\n");
+        CATCH_REQUIRE(cache.count() == 3);
+
+        CATCH_REQUIRE(cache.find(123, html));
+        CATCH_REQUIRE(html == "<p>one</p>\n");
+        CATCH_REQUIRE(cache.find(456, html));
+        CATCH_REQUIRE(html == "<p>two</p>\n");
+        CATCH_REQUIRE(cache.find(0, html));
+        CATCH_REQUIRE(html == "<p>zero</p>\n");
+
+        // a second object sees the same data
+        //
+        cm::render_cache other(path);
+        CATCH_REQUIRE(other.count() == 3);
+        CATCH_REQUIRE(other.find(456, html));
+        CATCH_REQUIRE(html == "<p>two</p>\n");
+
+        other.clear();
+        CATCH_REQUIRE(cache.count() == 0);
+        CATCH_REQUIRE(cache.data_size() == 0);
+        CATCH_REQUIRE_FALSE(cache.find(123, html));
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("cm: least recently used entries get evicted")
+    {
+        std::string const path(cache_path("eviction"));
+        std::string const html(1000, 'x');
+        cm::render_cache cache(path, 10 * 1024, 64);
+        cm::render_cache other(path, 10 * 1024);
+
+        std::string found;
+        for(std::uint64_t key(1); key <= 100; ++key)
+        {
+            cache.store(key, html);
+            CATCH_REQUIRE(cache.data_size() <= 10 * 1024);
+
+            // keep entry 1 hot
+            //
+            CATCH_REQUIRE(cache.find(1, found));
+        }
+        CATCH_REQUIRE(cache.find(100, found));
+        CATCH_REQUIRE(found == html);
+        CATCH_REQUIRE_FALSE(cache.find(2, found));
+
+        // the other object reopens the compacted data file
+        //
+        CATCH_REQUIRE(other.find(1, found));
+        CATCH_REQUIRE(found == html);
+        CATCH_REQUIRE(other.find(100, found));
+        CATCH_REQUIRE_FALSE(other.find(50, found));
+
+        // too large documents are ignored
+        //
+        cache.store(1000, std::string(20 * 1024, 'y'));
+        CATCH_REQUIRE_FALSE(cache.find(1000, found));
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("cm: process() uses the render cache")
+    {
+        std::string const input("# Title\n\nSome *text*.\n");
+        cm::render_cache::pointer_t cache(std::make_shared<cm::render_cache>(cache_path("process")));
+
+        cm::commonmark md;
+        md.set_render_cache(cache);
+        std::string const html(md.process(input));
+        CATCH_REQUIRE(cache->count() == 1);
+
+        std::string cached;
+        CATCH_REQUIRE(cache->find(md.get_cache_key(input), cached));
+        CATCH_REQUIRE(cached == html);
+
+        // use a fake entry to verify that the cache gets used
+        //
+        cache->clear();
+        cache->store(md.get_cache_key(input), "<p>cached</p>\n");
+        CATCH_REQUIRE(md.process(input) == "<p>cached</p>\n");
+
+        // different features, different key
+        //
+        cm::features f;
+        f.set_add_document_div(true);
+        md.set_features(f);
+        CATCH_REQUIRE(md.process(input) != "<p>cached</p>\n");
+        CATCH_REQUIRE(cache->count() == 2);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("cm: references of another document are not cached")
+    {
+        cm::render_cache::pointer_t cache(std::make_shared<cm::render_cache>(cache_path("references")));
+        cm::features f;
+        f.set_commonmark_compatible();
+
+        cm::commonmark md;
+        md.set_features(f);
+        md.set_render_cache(cache);
+        CATCH_REQUIRE(md.process("[a]: /first\n\n[a]\n") == "<p><a href=\"/first\">a</a></p>\n");
+        CATCH_REQUIRE(md.process("[a]: /second\n\n[a]\n") == "<p><a href=\"/second\">a</a></p>\n");
+        CATCH_REQUIRE(md.process("[a]\n") == "<p>[a]</p>\n");
+
+        std::string cached;
+        CATCH_REQUIRE(cache->find(md.get_cache_key("[a]\n"), cached));
+        CATCH_REQUIRE(cached == "<p>[a]</p>\n");
+
+        // a link added with add_link() changes the key
+        //
+        cm::commonmark user;
+        user.set_features(f);
+        user.set_render_cache(cache);
+        user.add_link("a", "/user", "", true);
+        CATCH_REQUIRE(user.process("[a]\n") == "<p><a href=\"/user\">a</a></p>\n");
+        CATCH_REQUIRE(md.process("[a]\n") == "<p>[a]</p>\n");
+        CATCH_REQUIRE(cache->count() == 4);
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("render_cache_threads", "[cache][thread]")
+{
+    CATCH_START_SECTION("cm: one render cache shared by several threads")
+    {
+        // a small cache so it gets compacted while the threads run
+        //
+        cm::render_cache cache(cache_path("threads"), 32 * 1024, 64);
+
+        std::atomic<int> errors(0);
+        std::atomic<int> hits(0);
+        std::vector<std::thread> threads;
+        for(int idx(0); idx < 4; ++idx)
+        {
+            threads.emplace_back([&cache, &errors, &hits, idx]()
+                {
+                    for(std::uint64_t count(0); count < 200; ++count)
+                    {
+                        std::uint64_t const key(idx * 1000 + count + 1);
+                        std::string const html(1000, static_cast<char>('a' + key % 26));
+                        cache.store(key, html);
+
+                        // an older entry may have been evicted, but if
+                        // found, it has to be the right HTML
+                        //
+                        for(std::uint64_t k(key); k > 0 && k + 5 > key; --k)
+                        {
+                            std::string found;
+                            if(cache.find(k, found))
+                            {
+                                ++hits;
+                                if(found != std::string(1000, static_cast<char>('a' + k % 26)))
+                                {
+                                    ++errors;
+                                }
+                            }
+                        }
+                        cache.count();
+                        cache.data_size();
+                    }
+                });
+        }
+        for(auto & t : threads)
+        {
+            t.join();
+        }
+
+        CATCH_REQUIRE(errors == 0);
+        CATCH_REQUIRE(hits > 0);
+        CATCH_REQUIRE(cache.data_size() <= 32 * 1024);
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("render_cache_errors", "[cache][error]")
+{
+    CATCH_START_SECTION("cm: invalid index file")
+    {
+        std::string const path(cache_path("invalid"));
+        {
+            cm::render_cache cache(path);
+        }
+        CATCH_REQUIRE(truncate((path + "/index").c_str(), 100) == 0);
+        CATCH_REQUIRE_THROWS_AS(cm::render_cache(path), cm::render_cache_error);
+    }
+    CATCH_END_SECTION()
+}
+
+
+
+// vim: ts=4 sw=4 et
@@ -0,0 +1,94 @@
+// Copyright (c) 2021-2022  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/commonmarkcpp
+// contact@m2osw.com
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+// self
+//
+#include    "catch_main.h"
+
+
+// commonmarkcpp lib
+//
+#include    <commonmarkcpp/sanitizer.h>
+
+
+
+CATCH_TEST_CASE("sanitizer", "[sanitizer]")
+{
+    CATCH_START_SECTION("cm: default allowlist")
+    {
+        cm::sanitizer s;
+        CATCH_REQUIRE(s.is_tag_allowed("a"));
+        CATCH_REQUIRE(s.is_tag_allowed("em"));
+        CATCH_REQUIRE_FALSE(s.is_tag_allowed("script"));
+        CATCH_REQUIRE_FALSE(s.is_tag_allowed("iframe"));
+        CATCH_REQUIRE(s.is_attribute_allowed("a", "href"));
+        CATCH_REQUIRE_FALSE(s.is_attribute_allowed("a", "onclick"));
+        CATCH_REQUIRE_FALSE(s.is_attribute_allowed("script", "src"));
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("cm: URL schemes")
+    {
+        cm::sanitizer s;
+        CATCH_REQUIRE(s.is_url_allowed("https://example.com/"));
+        CATCH_REQUIRE(s.is_url_allowed("HTTP://example.com/"));
+        CATCH_REQUIRE(s.is_url_allowed("mailto:someone@example.com"));
+        CATCH_REQUIRE(s.is_url_allowed("/relative/path?a=b:c"));
+        CATCH_REQUIRE(s.is_url_allowed("page.html#top"));
+        CATCH_REQUIRE(s.is_url_allowed(""));
+        CATCH_REQUIRE_FALSE(s.is_url_allowed("javascript:alert(1)"));
+        CATCH_REQUIRE_FALSE(s.is_url_allowed("JavaScript:alert(1)"));
+        CATCH_REQUIRE_FALSE(s.is_url_allowed(" javascript:alert(1)"));
+        CATCH_REQUIRE_FALSE(s.is_url_allowed("java\tscript:alert(1)"));
+        CATCH_REQUIRE_FALSE(s.is_url_allowed("javascript&#58;alert(1)"));
+        CATCH_REQUIRE_FALSE(s.is_url_allowed("data:text/html,x"));
+
+        s.allow_scheme("Data");
+        CATCH_REQUIRE(s.is_url_allowed("data:text/html,x"));
+
+        CATCH_REQUIRE(cm::sanitizer::is_url_attribute("href"));
+        CATCH_REQUIRE(cm::sanitizer::is_url_attribute("src"));
+        CATCH_REQUIRE_FALSE(cm::sanitizer::is_url_attribute("title"));
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("cm: custom allowlist")
+    {
+        cm::sanitizer s;
+        s.clear();
+        CATCH_REQUIRE_FALSE(s.is_tag_allowed("a"));
+        CATCH_REQUIRE_FALSE(s.is_url_allowed("https://example.com/"));
+        CATCH_REQUIRE(s.is_url_allowed("/relative"));
+
+        s.allow_tag("Span", "class  ID");
+        CATCH_REQUIRE(s.is_tag_allowed("span"));
+        CATCH_REQUIRE(s.is_attribute_allowed("span", "class"));
+        CATCH_REQUIRE(s.is_attribute_allowed("span", "id"));
+        CATCH_REQUIRE_FALSE(s.is_attribute_allowed("span", "style"));
+
+        s.allow_tag("span", "style");
+        CATCH_REQUIRE(s.is_attribute_allowed("span", "class"));
+        CATCH_REQUIRE(s.is_attribute_allowed("span", "style"));
+    }
+    CATCH_END_SECTION()
+}
+
+
+
+// vim: ts=4 sw=4 et
@@ -0,0 +1,76 @@
+// Copyright (c) 2021-2022  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/commonmarkcpp
+// contact@m2osw.com
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+// self
+//
+#include    "catch_main.h"
+
+
+// commonmarkcpp lib
+//
+#include    <commonmarkcpp/streaming_hash.h>
+
+
+
+CATCH_TEST_CASE("streaming_hash", "[hash]")
+{
+    CATCH_START_SECTION("cm: known hashes")
+    {
+        CATCH_REQUIRE(cm::streaming_hash::hash("", 0) == 0xEF46DB3751D8E999ULL);
+        CATCH_REQUIRE(cm::streaming_hash::hash("a", 1) == 0xD24EC4F1A98C6E5BULL);
+        CATCH_REQUIRE(cm::streaming_hash::hash("abc", 3) == 0x44BC2CF5AD770999ULL);
+
+        CATCH_REQUIRE(cm::streaming_hash::to_string(0xEF46DB3751D8E999ULL) == "ef46db3751d8e999");
+        CATCH_REQUIRE(cm::streaming_hash::to_string(1) == "0000000000000001");
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("cm: hash does not depend on chunk sizes")
+    {
+        std::string data;
+        for(int idx(0); idx < 1000; ++idx)
+        {
+            data += static_cast<char>(idx * 7 + 3);
+        }
+        std::uint64_t const expected(cm::streaming_hash::hash(data.data(), data.length()));
+
+        for(std::size_t chunk(1); chunk < 70; ++chunk)
+        {
+            cm::streaming_hash h;
+            for(std::size_t pos(0); pos < data.length(); pos += chunk)
+            {
+                h.add(data.data() + pos, std::min(chunk, data.length() - pos));
+            }
+            CATCH_REQUIRE(h.digest() == expected);
+        }
+
+        cm::streaming_hash h;
+        h.add(data);
+        CATCH_REQUIRE(h.digest() == expected);
+        h.reset();
+        CATCH_REQUIRE(h.digest() == cm::streaming_hash::hash("", 0));
+        h.reset(1);
+        CATCH_REQUIRE(h.digest() != cm::streaming_hash::hash("", 0));
+    }
+    CATCH_END_SECTION()
+}
+
+
+
+// vim: ts=4 sw=4 et
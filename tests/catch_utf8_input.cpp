@@ -0,0 +1,103 @@
+// Copyright (c) 2021-2022  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/commonmarkcpp
+// contact@m2osw.com
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+// self
+//
+#include    "catch_main.h"
+
+
+// commonmarkcpp lib
+//
+#include    <commonmarkcpp/commonmark.h>
+#include    <commonmarkcpp/utf8_input.h>
+
+
+
+CATCH_TEST_CASE("utf8_input", "[utf8]")
+{
+    CATCH_START_SECTION("cm: valid input is decoded as is")
+    {
+        std::string const input("ascii \xC3\xA9\xE6\x97\xA5\xE6\x9C\xAC\xF0\x9F\x98\x80 and a long ASCII part to go through the fast path\n");
+        CATCH_REQUIRE(cm::utf8_input::valid_length(input) == input.length());
+        CATCH_REQUIRE(cm::utf8_input::fix(input) == input);
+
+        cm::utf8_input in;
+        in.reset(input);
+        CATCH_REQUIRE(in.get() == U'a');
+        for(int idx(0); idx < 5; ++idx)
+        {
+            in.get();
+        }
+        CATCH_REQUIRE(in.get() == U'é');
+        std::string::size_type const position(in.position());
+        CATCH_REQUIRE(in.get() == U'日');
+        CATCH_REQUIRE(in.get() == U'本');
+        CATCH_REQUIRE(in.get() == U'\U0001F600');
+        CATCH_REQUIRE(in.peek_byte() == ' ');
+        in.set_position(position);
+        CATCH_REQUIRE(in.get() == U'日');
+
+        in.set_position(input.length() - 1);
+        CATCH_REQUIRE(in.get() == U'\n');
+        CATCH_REQUIRE(in.peek_byte() == -1);
+        CATCH_REQUIRE(in.get() == libutf8::EOS);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("cm: invalid sequences are replaced")
+    {
+        // lone continuation byte, invalid lead bytes
+        //
+        CATCH_REQUIRE(cm::utf8_input::fix("a\x80z") == "a\xEF\xBF\xBDz");
+        CATCH_REQUIRE(cm::utf8_input::fix("\xC0\xAF") == "\xEF\xBF\xBD\xEF\xBF\xBD");
+        CATCH_REQUIRE(cm::utf8_input::fix("\xFF") == "\xEF\xBF\xBD");
+
+        // overlong, surrogate, and out of range characters
+        //
+        CATCH_REQUIRE(cm::utf8_input::fix("\xE0\x80\x80") == "\xEF\xBF\xBD\xEF\xBF\xBD\xEF\xBF\xBD");
+        CATCH_REQUIRE(cm::utf8_input::fix("\xED\xA0\x80") == "\xEF\xBF\xBD\xEF\xBF\xBD\xEF\xBF\xBD");
+        CATCH_REQUIRE(cm::utf8_input::fix("\xF4\x90\x80\x80") == "\xEF\xBF\xBD\xEF\xBF\xBD\xEF\xBF\xBD\xEF\xBF\xBD");
+
+        // truncated sequences count as one character
+        //
+        CATCH_REQUIRE(cm::utf8_input::fix("\xE6\x97z") == "\xEF\xBF\xBDz");
+        CATCH_REQUIRE(cm::utf8_input::fix("z\xF0\x9F\x98") == "z\xEF\xBF\xBD");
+
+        std::string const input(std::string(40, 'a') + "\xE6\x97" + std::string(40, 'b'));
+        CATCH_REQUIRE(cm::utf8_input::valid_length(input) == 40);
+        CATCH_REQUIRE(cm::utf8_input::valid_length(input, 42) == input.length());
+
+        cm::utf8_input in;
+        in.reset(input);
+        in.set_position(40);
+        CATCH_REQUIRE(in.get() == U'�');
+        CATCH_REQUIRE(in.get() == U'b');
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("cm: invalid sequences in a document")
+    {
+        cm::commonmark md;
+        CATCH_REQUIRE(md.process("bad \xE6\x97 and \xC0 chars\n") == "<p>bad \xEF\xBF\xBD and \xEF\xBF\xBD chars</p>\n");
+    }
+    CATCH_END_SECTION()
+}
+
+
+// vim: ts=4 sw=4 et
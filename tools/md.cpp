@@ -30,7 +30,7 @@
 // commonmarkcpp
 //
 #include    "commonmarkcpp/commonmark.h"
-
+#include    "commonmarkcpp/render_cache.h"
 #include    "commonmarkcpp/version.h"
 
 
@@ -42,15 +42,43 @@
 
 // snapdev
 //
+#include    <snapdev/file_contents.h>
 #include    <snapdev/not_reached.h>
 #include    <snapdev/stringize.h>
 
 
 // eventdispatcher
 //
+#include    <eventdispatcher/communicator.h>
+#include    <eventdispatcher/file_changed.h>
 #include    <eventdispatcher/signal_handler.h>
 
 
+// cppthread
+//
+#include    <cppthread/guard.h>
+#include    <cppthread/mutex.h>
+#include    <cppthread/runner.h>
+#include    <cppthread/thread.h>
+
+
+// C++
+//
+#include    <algorithm>
+#include    <chrono>
+#include    <deque>
+#include    <filesystem>
+#include    <iostream>
+#include    <map>
+#include    <thread>
+
+
+// C
+//
+#include    <stdio.h>
+#include    <unistd.h>
+
+
 // last include
 //
 #include    <snapdev/poison.h>
@@ -63,6 +91,21 @@ namespace
 
 const advgetopt::option g_options[] =
 {
+    advgetopt::define_option(
+          advgetopt::Name("cache")
+        , advgetopt::Flags(advgetopt::all_flags<
+              advgetopt::GETOPT_FLAG_REQUIRED
+            , advgetopt::GETOPT_FLAG_GROUP_OPTIONS>())
+        , advgetopt::Help("directory of a render cache used to skip files which did not change.")
+    ),
+    advgetopt::define_option(
+          advgetopt::Name("cache-size")
+        , advgetopt::Flags(advgetopt::all_flags<
+              advgetopt::GETOPT_FLAG_REQUIRED
+            , advgetopt::GETOPT_FLAG_GROUP_OPTIONS>())
+        , advgetopt::DefaultValue("268435456")
+        , advgetopt::Help("maximum size of the render cache data in bytes.")
+    ),
     advgetopt::define_option(
           advgetopt::Name("extensions")
         , advgetopt::ShortName('x')
@@ -70,6 +113,35 @@ const advgetopt::option g_options[] =
               advgetopt::GETOPT_FLAG_GROUP_OPTIONS>())
         , advgetopt::Help("allow our markdown extensions.")
     ),
+    advgetopt::define_option(
+          advgetopt::Name("output-directory")
+        , advgetopt::ShortName('o')
+        , advgetopt::Flags(advgetopt::all_flags<
+              advgetopt::GETOPT_FLAG_REQUIRED
+            , advgetopt::GETOPT_FLAG_GROUP_OPTIONS>())
+        , advgetopt::Help("save the HTML files in this directory; input directories get converted recursively.")
+    ),
+    advgetopt::define_option(
+          advgetopt::Name("report")
+        , advgetopt::Flags(advgetopt::all_flags<
+              advgetopt::GETOPT_FLAG_GROUP_OPTIONS>())
+        , advgetopt::Help("print statistics, including the critical path, once all the files were converted.")
+    ),
+    advgetopt::define_option(
+          advgetopt::Name("threads")
+        , advgetopt::Flags(advgetopt::all_flags<
+              advgetopt::GETOPT_FLAG_REQUIRED
+            , advgetopt::GETOPT_FLAG_GROUP_OPTIONS>())
+        , advgetopt::DefaultValue("0")
+        , advgetopt::Help("number of threads used to convert files with --output-directory; 0 means one per CPU.")
+    ),
+    advgetopt::define_option(
+          advgetopt::Name("watch")
+        , advgetopt::ShortName('w')
+        , advgetopt::Flags(advgetopt::all_flags<
+              advgetopt::GETOPT_FLAG_GROUP_OPTIONS>())
+        , advgetopt::Help("after converting the input directories, watch them and convert the files again as they change (requires --output-directory).")
+    ),
     advgetopt::define_option(
           advgetopt::Name("filenames")
         , advgetopt::Flags(advgetopt::all_flags<
@@ -139,6 +211,138 @@ advgetopt::options_environment const g_options_environment =
 
 
 
+struct job_t
+{
+    typedef std::vector<job_t>      vector_t;
+
+    std::string                     f_input = std::string();
+    std::string                     f_output = std::string();
+    std::uintmax_t                  f_size = 0;
+    double                          f_duration = 0.0;       // in seconds
+    std::size_t                     f_worker = 0;
+    bool                            f_success = false;
+};
+
+
+/** \brief Distribute the jobs between the worker threads.
+ *
+ * Each worker has its own queue of jobs. The jobs are sorted by size,
+ * the largest first, and each one is added to the queue with the
+ * smallest number of bytes so far. A worker takes the jobs from the
+ * front of its own queue. Once its queue is empty, it steals the next
+ * job from the queue with the most bytes left so no core stays idle
+ * behind a few very large files.
+ */
+class scheduler
+{
+public:
+                                    scheduler(job_t::vector_t & jobs, std::size_t workers);
+
+    job_t *                         next(std::size_t worker);
+
+private:
+    struct queue_t
+    {
+        cppthread::mutex            f_mutex = cppthread::mutex();
+        std::deque<job_t *>         f_jobs = std::deque<job_t *>();
+        std::uintmax_t              f_bytes = 0;
+    };
+
+    job_t *                         pop(queue_t & q);
+
+    std::vector<std::unique_ptr<queue_t>>
+                                    f_queues = std::vector<std::unique_ptr<queue_t>>();
+};
+
+
+scheduler::scheduler(job_t::vector_t & jobs, std::size_t workers)
+{
+    for(std::size_t idx(0); idx < workers; ++idx)
+    {
+        f_queues.push_back(std::make_unique<queue_t>());
+    }
+
+    std::vector<job_t *> sorted;
+    sorted.reserve(jobs.size());
+    for(auto & j : jobs)
+    {
+        sorted.push_back(&j);
+    }
+    std::stable_sort(
+          sorted.begin()
+        , sorted.end()
+        , [](job_t const * a, job_t const * b)
+          {
+              return a->f_size > b->f_size;
+          });
+
+    for(auto j : sorted)
+    {
+        auto q(std::min_element(
+                  f_queues.begin()
+                , f_queues.end()
+                , [](std::unique_ptr<queue_t> const & a, std::unique_ptr<queue_t> const & b)
+                  {
+                      return a->f_bytes < b->f_bytes;
+                  }));
+        (*q)->f_jobs.push_back(j);
+        (*q)->f_bytes += j->f_size;
+    }
+}
+
+
+job_t * scheduler::next(std::size_t worker)
+{
+    job_t * j(pop(*f_queues[worker]));
+    while(j == nullptr)
+    {
+        // steal from the queue with the most work left
+        //
+        queue_t * victim(nullptr);
+        std::uintmax_t most(0);
+        bool empty(true);
+        for(auto & q : f_queues)
+        {
+            cppthread::guard lock(q->f_mutex);
+            if(!q->f_jobs.empty())
+            {
+                empty = false;
+                if(q->f_bytes >= most)
+                {
+                    most = q->f_bytes;
+                    victim = q.get();
+                }
+            }
+        }
+        if(empty)
+        {
+            return nullptr;
+        }
+        j = pop(*victim);
+    }
+    return j;
+}
+
+
+job_t * scheduler::pop(queue_t & q)
+{
+    cppthread::guard lock(q.f_mutex);
+    if(q.f_jobs.empty())
+    {
+        return nullptr;
+    }
+    job_t * j(q.f_jobs.front());
+    q.f_jobs.pop_front();
+    q.f_bytes -= j->f_size;
+    return j;
+}
+
+
+
+
+class watcher;
+
+
 class markdown
 {
 public:
@@ -146,11 +350,130 @@ public:
 
     int                             run();
 
+    void                            setup(cm::commonmark & md);
+    bool                            convert(cm::commonmark & md, std::string const & filename, std::string & html);
+    bool                            save(std::string const & filename, std::string const & html);
+    void                            file_changed(std::string const & directory, std::string const & name);
+
 private:
+    int                             run_sequential();
+    int                             run_parallel();
+    int                             run_watch();
+    void                            watch_tree(std::string const & directory, std::filesystem::path const & output);
+    void                            update(std::string const & input, std::filesystem::path const & output);
+    bool                            collect_jobs(job_t::vector_t & jobs);
+    void                            report(job_t::vector_t const & jobs, std::size_t workers, double wall_time);
+
     advgetopt::getopt               f_opt;
+    std::shared_ptr<watcher>        f_watcher = std::shared_ptr<watcher>();
+    cm::commonmark                  f_watch_md = cm::commonmark();
+    std::map<std::string, std::filesystem::path>
+                                    f_watched = std::map<std::string, std::filesystem::path>();
+    std::map<std::string, std::uint64_t>
+                                    f_keys = std::map<std::string, std::uint64_t>();
+};
+
+
+
+
+/** \brief Listen for changes in the watched directories.
+ *
+ * Each event is forwarded to the markdown object which converts the
+ * file again if it still exists and changed.
+ */
+class watcher
+    : public ed::file_changed
+{
+public:
+    typedef std::shared_ptr<watcher>    pointer_t;
+
+                                    watcher(markdown * md);
+
+    virtual void                    process_event(ed::file_changed::event const & watch_event) override;
+
+private:
+    markdown *                      f_markdown = nullptr;
+};
+
+
+watcher::watcher(markdown * md)
+    : f_markdown(md)
+{
+}
+
+
+void watcher::process_event(ed::file_changed::event const & watch_event)
+{
+    f_markdown->file_changed(watch_event.get_watched_path(), watch_event.get_filename());
+}
+
+
+
+
+class worker
+    : public cppthread::runner
+{
+public:
+                                    worker(markdown * md, scheduler & s, std::size_t id);
+
+    virtual void                    run() override;
+
+    double                          busy() const;
+
+private:
+    markdown *                      f_markdown = nullptr;
+    scheduler &                     f_scheduler;
+    std::size_t const               f_id;
+    double                          f_busy = 0.0;
 };
 
 
+worker::worker(markdown * md, scheduler & s, std::size_t id)
+    : runner("md-worker-" + std::to_string(id))
+    , f_markdown(md)
+    , f_scheduler(s)
+    , f_id(id)
+{
+}
+
+
+/** \brief Convert the jobs of this worker.
+ *
+ * The worker uses a single commonmark object for all of its jobs so
+ * its buffers get reused.
+ */
+void worker::run()
+{
+    cm::commonmark md;
+    f_markdown->setup(md);
+
+    for(;;)
+    {
+        job_t * j(f_scheduler.next(f_id));
+        if(j == nullptr)
+        {
+            break;
+        }
+
+        std::chrono::steady_clock::time_point const start(std::chrono::steady_clock::now());
+        std::string html;
+        j->f_success = f_markdown->convert(md, j->f_input, html)
+                    && f_markdown->save(j->f_output, html);
+        std::chrono::duration<double> const duration(std::chrono::steady_clock::now() - start);
+
+        j->f_duration = duration.count();
+        j->f_worker = f_id;
+        f_busy += j->f_duration;
+    }
+}
+
+
+double worker::busy() const
+{
+    return f_busy;
+}
+
+
 
 
 markdown::markdown(int argc, char * argv[])
@@ -162,10 +485,544 @@ markdown::markdown(int argc, char * argv[])
 
 int markdown::run()
 {
+    if(f_opt.is_defined("watch"))
+    {
+        if(!f_opt.is_defined("output-directory"))
+        {
+            std::cerr << "error: --watch requires --output-directory.\n";
+            return 1;
+        }
+        int const exit_code(run_parallel());
+        if(exit_code != 0)
+        {
+            return exit_code;
+        }
+        return run_watch();
+    }
+
+    if(f_opt.is_defined("output-directory"))
+    {
+        return run_parallel();
+    }
+
+    return run_sequential();
+}
+
+
+/** \brief Convert the input files and print the HTML to stdout.
+ *
+ * \return The exit code.
+ */
+int markdown::run_sequential()
+{
+    cm::commonmark md;
+    setup(md);
+
+    int exit_code(0);
+    std::size_t const max(f_opt.size("filenames"));
+    for(std::size_t idx(0); idx < max; ++idx)
+    {
+        std::string const filename(f_opt.get_string("filenames", idx));
+        if(std::filesystem::is_directory(filename))
+        {
+            std::cerr
+                << "error: \""
+                << filename
+                << "\" is a directory; use --output-directory to convert directories.\n";
+            exit_code = 1;
+            continue;
+        }
+
+        std::string html;
+        if(!convert(md, filename, html))
+        {
+            exit_code = 1;
+            continue;
+        }
+        std::cout << html;
+    }
+
+    return exit_code;
+}
+
+
+/** \brief Convert the input files and directories to HTML files.
+ *
+ * The input directories are scanned recursively for `.md` files. Each
+ * file is converted to a `.html` file in the output directory, at the
+ * same relative path as in the input directory.
+ *
+ * The files are converted by a pool of threads (see the scheduler class).
+ *
+ * \return The exit code.
+ */
+int markdown::run_parallel()
+{
+    job_t::vector_t jobs;
+    if(!collect_jobs(jobs))
+    {
+        return 1;
+    }
+
+    std::size_t workers(f_opt.get_long("threads"));
+    if(workers == 0)
+    {
+        workers = std::max(1U, std::thread::hardware_concurrency());
+    }
+    workers = std::min(workers, std::max<std::size_t>(jobs.size(), 1));
+
+    std::chrono::steady_clock::time_point const start(std::chrono::steady_clock::now());
+
+    scheduler s(jobs, workers);
+    std::vector<std::shared_ptr<worker>> runners;
+    std::vector<std::shared_ptr<cppthread::thread>> threads;
+    for(std::size_t idx(0); idx < workers; ++idx)
+    {
+        runners.push_back(std::make_shared<worker>(this, s, idx));
+        threads.push_back(std::make_shared<cppthread::thread>("md-worker", runners.back().get()));
+        threads.back()->start();
+    }
+    for(auto & t : threads)
+    {
+        t->stop();
+    }
+
+    std::chrono::duration<double> const wall_time(std::chrono::steady_clock::now() - start);
+
+    if(f_opt.is_defined("report"))
+    {
+        report(jobs, workers, wall_time.count());
+    }
+
+    for(auto const & j : jobs)
+    {
+        if(!j.f_success)
+        {
+            return 1;
+        }
+    }
     return 0;
 }
 
 
+/** \brief Search for the files to convert.
+ *
+ * \param[out] jobs  The list of files to convert.
+ *
+ * \return true if all the input files and directories were found.
+ */
+bool markdown::collect_jobs(job_t::vector_t & jobs)
+{
+    std::filesystem::path const output_directory(f_opt.get_string("output-directory"));
+
+    bool result(true);
+    std::size_t const max(f_opt.size("filenames"));
+    for(std::size_t idx(0); idx < max; ++idx)
+    {
+        std::filesystem::path const filename(f_opt.get_string("filenames", idx));
+        std::error_code ec;
+        if(std::filesystem::is_directory(filename, ec))
+        {
+            for(std::filesystem::recursive_directory_iterator it(filename, ec), end;
+                !ec && it != end;
+                it.increment(ec))
+            {
+                if(!it->is_regular_file(ec)
+                || it->path().extension() != ".md")
+                {
+                    continue;
+                }
+                job_t j;
+                j.f_input = it->path().string();
+                j.f_output = (output_directory
+                            / it->path().lexically_relative(filename)).replace_extension(".html").string();
+                j.f_size = it->file_size(ec);
+                jobs.push_back(j);
+            }
+        }
+        else if(std::filesystem::is_regular_file(filename, ec))
+        {
+            job_t j;
+            j.f_input = filename.string();
+            j.f_output = (output_directory / filename.filename()).replace_extension(".html").string();
+            j.f_size = std::filesystem::file_size(filename, ec);
+            jobs.push_back(j);
+        }
+        else
+        {
+            ec = std::make_error_code(std::errc::no_such_file_or_directory);
+        }
+        if(ec)
+        {
+            std::cerr
+                << "error: could not read \""
+                << filename.string()
+                << "\": "
+                << ec.message()
+                << ".\n";
+            result = false;
+        }
+    }
+
+    return result;
+}
+
+
+/** \brief Print statistics about the conversion.
+ *
+ * The report shows how busy each worker was and the files which took
+ * the most time to convert.
+ *
+ * With independent files, the critical path is the longest of the
+ * slowest file and the total work divided by the number of workers.
+ * The wall time can't be shorter than that. When the slowest file is
+ * the bound, splitting that file is the only way to speed up the build.
+ *
+ * \param[in] jobs  The converted files.
+ * \param[in] workers  The number of worker threads.
+ * \param[in] wall_time  The time it took to convert all the files.
+ */
+void markdown::report(job_t::vector_t const & jobs, std::size_t workers, double wall_time)
+{
+    std::vector<job_t const *> sorted;
+    std::uintmax_t bytes(0);
+    double total(0.0);
+    std::vector<double> busy(workers);
+    std::vector<std::size_t> count(workers);
+    for(auto const & j : jobs)
+    {
+        sorted.push_back(&j);
+        bytes += j.f_size;
+        total += j.f_duration;
+        busy[j.f_worker] += j.f_duration;
+        ++count[j.f_worker];
+    }
+    std::sort(
+          sorted.begin()
+        , sorted.end()
+        , [](job_t const * a, job_t const * b)
+          {
+              return a->f_duration > b->f_duration;
+          });
+
+    std::cout
+        << "files: " << jobs.size()
+        << ", bytes: " << bytes
+        << ", threads: " << workers
+        << ", wall time: " << wall_time << "s\n";
+    for(std::size_t idx(0); idx < workers; ++idx)
+    {
+        std::cout
+            << "worker " << idx
+            << ": " << count[idx] << " files"
+            << ", busy " << busy[idx] << "s\n";
+    }
+
+    std::cout << "slowest files:\n";
+    for(std::size_t idx(0); idx < sorted.size() && idx < 10; ++idx)
+    {
+        std::cout
+            << "  " << sorted[idx]->f_duration << "s"
+            << "  " << sorted[idx]->f_size << " bytes"
+            << "  " << sorted[idx]->f_input << "\n";
+    }
+
+    if(!sorted.empty())
+    {
+        double const balanced(total / workers);
+        double const slowest(sorted[0]->f_duration);
+        std::cout << "critical path: ";
+        if(slowest >= balanced)
+        {
+            std::cout << slowest << "s, bound by \"" << sorted[0]->f_input << "\"\n";
+        }
+        else
+        {
+            std::cout << balanced << "s, bound by the total work (" << total << "s)\n";
+        }
+    }
+}
+
+
+/** \brief Setup a commonmark object as per the command line options.
+ *
+ * Each commonmark object gets its own render_cache object so the
+ * threads do not wait on each other's render_cache mutex.
+ *
+ * \param[in,out] md  The commonmark object to setup.
+ */
+void markdown::setup(cm::commonmark & md)
+{
+    if(!f_opt.is_defined("extensions"))
+    {
+        cm::features f;
+        f.set_commonmark_compatible();
+        md.set_features(f);
+    }
+    if(f_opt.is_defined("cache"))
+    {
+        md.set_render_cache(std::make_shared<cm::render_cache>(
+                              f_opt.get_string("cache")
+                            , f_opt.get_long("cache-size")));
+    }
+}
+
+
+/** \brief Convert one file to HTML.
+ *
+ * The file gets loaded and converted with \p md. When a render cache is
+ * used, a file which did not change since the last run is not parsed
+ * again.
+ *
+ * \param[in,out] md  The commonmark object used to convert the file.
+ * \param[in] filename  The name of the markdown file.
+ * \param[out] html  The resulting HTML.
+ *
+ * \return true if the file could be read.
+ */
+bool markdown::convert(cm::commonmark & md, std::string const & filename, std::string & html)
+{
+    snapdev::file_contents input(filename);
+    if(!input.read_all())
+    {
+        std::cerr
+            << "error: could not read \""
+            << filename
+            << "\": "
+            << input.last_error()
+            << ".\n";
+        return false;
+    }
+
+    html = md.process(input.contents());
+    return true;
+}
+
+
+/** \brief Save the HTML of a file.
+ *
+ * The missing directories get created.
+ *
+ * The HTML is first saved in a temporary file which then gets renamed.
+ * This way a reader (i.e. a preview server) never sees a partial file.
+ *
+ * \param[in] filename  The name of the output file.
+ * \param[in] html  The HTML to save.
+ *
+ * \return true if the file was saved.
+ */
+bool markdown::save(std::string const & filename, std::string const & html)
+{
+    std::string const tmp(filename + ".tmp~");
+    snapdev::file_contents output(tmp, true);
+    output.contents(html);
+    if(!output.write_all())
+    {
+        std::cerr
+            << "error: could not write \""
+            << tmp
+            << "\": "
+            << output.last_error()
+            << ".\n";
+        return false;
+    }
+    if(rename(tmp.c_str(), filename.c_str()) != 0)
+    {
+        std::cerr
+            << "error: could not rename \""
+            << tmp
+            << "\" to \""
+            << filename
+            << "\".\n";
+        unlink(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+
+/** \brief Watch the input directories.
+ *
+ * This function watches the input directories and their subdirectories
+ * and converts the files again each time they change. It never returns
+ * unless the communicator gets stopped (i.e. on a Ctrl-C).
+ *
+ * A single commonmark object is used for all the conversions so its
+ * buffers are already allocated. This is safe since process() drops
+ * the link reference definitions of the previous file, so a file only
+ * sees its own references. The key of the last version of each
+ * file is kept in memory so events which do not change a file (i.e. a
+ * touch or multiple events for one save) do not trigger a conversion.
+ *
+ * \return The exit code.
+ */
+int markdown::run_watch()
+{
+    setup(f_watch_md);
+    f_watcher = std::make_shared<watcher>(this);
+
+    std::filesystem::path const output_directory(f_opt.get_string("output-directory"));
+    std::size_t const max(f_opt.size("filenames"));
+    for(std::size_t idx(0); idx < max; ++idx)
+    {
+        std::string const filename(f_opt.get_string("filenames", idx));
+        if(std::filesystem::is_directory(filename))
+        {
+            watch_tree(filename, output_directory);
+        }
+    }
+
+    ed::communicator::instance()->add_connection(f_watcher);
+    ed::communicator::instance()->run();
+
+    return 0;
+}
+
+
+/** \brief Watch a directory and its subdirectories.
+ *
+ * inotify does not watch subdirectories so each one is added
+ * separately.
+ *
+ * \param[in] directory  The directory to watch.
+ * \param[in] output  The output directory corresponding to \p directory.
+ */
+void markdown::watch_tree(std::string const & directory, std::filesystem::path const & output)
+{
+    if(f_watched.find(directory) != f_watched.end())
+    {
+        return;
+    }
+
+    f_watcher->watch_directory(
+              directory
+            , ed::SNAP_FILE_CHANGED_EVENT_WRITE
+            | ed::SNAP_FILE_CHANGED_EVENT_CREATED
+            | ed::SNAP_FILE_CHANGED_EVENT_DELETED);
+    f_watched[directory] = output;
+
+    std::error_code ec;
+    for(std::filesystem::directory_iterator it(directory, ec), end;
+        !ec && it != end;
+        it.increment(ec))
+    {
+        if(it->is_directory(ec))
+        {
+            watch_tree(it->path().string(), output / it->path().filename());
+        }
+    }
+}
+
+
+/** \brief Handle a change in a watched directory.
+ *
+ * If \p name is a new directory, it gets watched and its files get
+ * converted. If it is a markdown file, it gets converted again or, if
+ * it was deleted, its HTML file gets deleted too.
+ *
+ * \param[in] directory  The watched directory.
+ * \param[in] name  The name of the file which changed in \p directory.
+ */
+void markdown::file_changed(std::string const & directory, std::string const & name)
+{
+    auto const it(f_watched.find(directory));
+    if(it == f_watched.end()
+    || name.empty())
+    {
+        return;
+    }
+
+    std::filesystem::path const input(std::filesystem::path(directory) / name);
+    std::filesystem::path const output(it->second / name);
+
+    std::error_code ec;
+    if(std::filesystem::is_directory(input, ec))
+    {
+        watch_tree(input.string(), output);
+        for(std::filesystem::recursive_directory_iterator r(input, ec), end;
+            !ec && r != end;
+            r.increment(ec))
+        {
+            if(r->path().extension() == ".md")
+            {
+                update(r->path().string(), output / r->path().lexically_relative(input));
+            }
+        }
+        return;
+    }
+
+    if(input.extension() == ".md")
+    {
+        update(input.string(), output);
+    }
+}
+
+
+/** \brief Convert one file again.
+ *
+ * The file is converted with the watch commonmark object. The cache key
+ * only depends on the settings of that object and the contents of the
+ * file, not on the files converted before. If the key did not change
+ * since the last conversion, the output file is left alone.
+ *
+ * \param[in] input  The markdown file which changed.
+ * \param[in] output  The output file, the extension gets replaced.
+ */
+void markdown::update(std::string const & input, std::filesystem::path const & output)
+{
+    std::string const html_filename(std::filesystem::path(output).replace_extension(".html").string());
+
+    std::chrono::steady_clock::time_point const start(std::chrono::steady_clock::now());
+
+    std::error_code ec;
+    if(!std::filesystem::exists(input, ec))
+    {
+        // the file was deleted or renamed
+        //
+        f_keys.erase(input);
+        unlink(html_filename.c_str());
+        return;
+    }
+
+    snapdev::file_contents contents(input);
+    if(!contents.read_all())
+    {
+        std::cerr
+            << "error: could not read \""
+            << input
+            << "\": "
+            << contents.last_error()
+            << ".\n";
+        return;
+    }
+
+    std::uint64_t const key(f_watch_md.get_cache_key(contents.contents()));
+    auto const it(f_keys.find(input));
+    if(it != f_keys.end()
+    && it->second == key)
+    {
+        return;
+    }
+
+    if(!save(html_filename, f_watch_md.process(contents.contents())))
+    {
+        return;
+    }
+    f_keys[input] = key;
+
+    if(f_opt.is_defined("report"))
+    {
+        std::chrono::duration<double> const duration(std::chrono::steady_clock::now() - start);
+        std::cout
+            << html_filename
+            << " updated in "
+            << duration.count() * 1000.0
+            << "ms\n"
+            << std::flush;
+    }
+}
+
+
 
 
 